@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Turn a results directory of bench/run.sh into CSV, one line per run and operation class:
+
+    ./bench/parse.py bench-results/nvme0n2-20240815-120000 > results.csv
+
+Reads and writes come from the fio JSON output, resets and finishes from the blktrace of the storm
+runs: the "reset" and "finish" rows have the queue to completion latencies, which include the time
+held back by the scheduler, the "reset_device" and "finish_device" rows the issue to completion
+latencies. Finish storms reset every finished zone, those resets are reported as well. Throughput is
+in IOPS and KiB/s, latencies are completion latencies in microseconds.
+"""
+import csv
+import json
+import os
+import sys
+
+FIELDS = ["drive", "firmware", "scheduler", "workload", "qd", "zones", "knob", "value",
+          "op", "count", "iops", "bw_kib", "p50_us", "p99_us", "p99.9_us"]
+PERCENTILES = {"p50_us": "50.000000", "p99_us": "99.000000", "p99.9_us": "99.900000"}
+
+
+def read_meta(path):
+    meta = {}
+    with open(path) as f:
+        for line in f:
+            key, _, value = line.rstrip("\n").partition("=")
+            meta[key] = value
+    return meta
+
+
+def fio_rows(path):
+    with open(path) as f:
+        text = f.read()
+    # fio may print warnings before the JSON document
+    report = json.loads(text[text.index("{"):])
+    for op in ("read", "write"):
+        ios = sum(job[op]["total_ios"] for job in report["jobs"])
+        if not ios:
+            continue
+        row = {
+            "op": op,
+            "count": ios,
+            "iops": round(sum(job[op]["iops"] for job in report["jobs"]), 1),
+            "bw_kib": sum(job[op]["bw"] for job in report["jobs"]),
+        }
+        # with group_reporting there is a single job per operation
+        clat = report["jobs"][0][op]["clat_ns"]
+        for field, key in PERCENTILES.items():
+            row[field] = round(clat.get("percentile", {}).get(key, 0) / 1000, 1)
+        yield row
+
+
+def percentile(values, permille):
+    """Nearest-rank percentile of sorted @values"""
+    index = max(0, (len(values) * permille + 999) // 1000 - 1)
+    return values[min(index, len(values) - 1)]
+
+
+def trace_ns(time):
+    seconds, _, fraction = time.partition(".")
+    return int(seconds) * 1000000000 + int(fraction.ljust(9, "0")[:9])
+
+
+def trace_latencies(storm, trace):
+    """Q2C and D2C latencies in ns per operation of the storm log (operation and sector per
+    line, in issue order) from a blkparse trace of "action rwbs sector sectors time" lines.
+    Management operations have no data direction (N) and no data, zone appends are N with
+    data. A storm zone has one operation in flight at a time, so trace events are matched to
+    the storm operations by sector, in order. Zone resets of fio itself are not in the log."""
+    pending = {}
+    with open(storm) as f:
+        for line in f:
+            op, sector = line.split()
+            pending.setdefault(sector, []).append(op)
+    for ops in pending.values():
+        ops.reverse()
+
+    queued, issued, latencies = {}, {}, {}
+    with open(trace) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 5 or "N" not in fields[1] or fields[3] != "0":
+                continue
+            action, _, sector, _, time = fields
+            ns = trace_ns(time)
+            if action == "Q" and pending.get(sector):
+                queued[sector] = (pending[sector].pop(), ns)
+            elif action == "D" and sector in queued:
+                issued[sector] = ns
+            elif action == "C" and sector in queued:
+                op, start = queued.pop(sector)
+                latencies.setdefault(op, []).append(ns - start)
+                if sector in issued:
+                    latencies.setdefault(op + "_device", []).append(ns - issued.pop(sector))
+    return latencies
+
+
+def storm_rows(storm, trace, runtime):
+    for op, values in sorted(trace_latencies(storm, trace).items()):
+        values.sort()
+        yield {
+            "op": op,
+            "count": len(values),
+            "iops": round(len(values) / runtime, 1) if runtime else 0,
+            "bw_kib": 0,
+            "p50_us": round(percentile(values, 500) / 1000, 1),
+            "p99_us": round(percentile(values, 990) / 1000, 1),
+            "p99.9_us": round(percentile(values, 999) / 1000, 1),
+        }
+
+
+def fio_runtime(path):
+    with open(path) as f:
+        text = f.read()
+    report = json.loads(text[text.index("{"):])
+    return max(job["job_runtime"] for job in report["jobs"]) / 1000
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(f"usage: {sys.argv[0]} <results-dir>")
+    results = sys.argv[1]
+
+    out = csv.DictWriter(sys.stdout, fieldnames=FIELDS)
+    out.writeheader()
+    for name in sorted(os.listdir(results)):
+        if not name.endswith(".meta"):
+            continue
+        tag = os.path.join(results, name[:-len(".meta")])
+        if not os.path.exists(tag + ".json"):
+            print(f"{tag}: no fio output, skipped", file=sys.stderr)
+            continue
+        meta = read_meta(tag + ".meta")
+        for row in fio_rows(tag + ".json"):
+            out.writerow({**meta, **row})
+        if os.path.exists(tag + ".storm") and os.path.exists(tag + ".trace"):
+            for row in storm_rows(tag + ".storm", tag + ".trace",
+                                  fio_runtime(tag + ".json")):
+                out.writerow({**meta, **row})
+
+
+if __name__ == "__main__":
+    main()
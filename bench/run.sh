@@ -0,0 +1,197 @@
+#!/bin/bash
+#
+# Interference benchmark of ZINC against mq-deadline on a ZNS drive, see README.md.
+#
+#   sudo ./bench/run.sh nvme0n2 [results-dir]
+#
+# For every scheduler, workload, queue depth and number of zones a fio run is recorded in the
+# results directory, with the resets and finishes of the storm workloads and a blktrace of them. With
+# BENCH_SWEEP, every value of every listed ZINC knob is benchmarked as well, one knob at a time.
+# bench/parse.py turns the results directory into CSV.
+#
+# ALL DATA ON THE DRIVE IS LOST.
+#
+set -euo pipefail
+
+DEV=${1:?usage: $0 <nvme*n*> [results-dir]}
+DEV=${DEV#/dev/}
+RESULTS=${2:-bench-results/$DEV-$(date +%Y%m%d-%H%M%S)}
+BENCH=$(cd "$(dirname "$0")" && pwd)
+
+: "${BENCH_SCHEDULERS:=zinc mq-deadline}"
+: "${BENCH_WORKLOADS:=write mixed reset-storm finish-storm}"
+: "${BENCH_QDS:=1 16}"
+: "${BENCH_ZONE_COUNTS:=2 8}"
+: "${BENCH_RUNTIME:=30}"		# in seconds, per run
+: "${BENCH_BS:=128k}"
+: "${BENCH_ENGINE:=io_uring}"
+: "${BENCH_STORM_ZONES:=4}"		# zones reset or finished by a storm
+: "${BENCH_STORM_FILL_MB:=64}"		# data written to a zone before it is reset in a reset storm
+: "${BENCH_SWEEP:=}"			# e.g. "reset_command_tokens=500,2000,8000 reset_epoch_interval_us=4000,64000"
+
+SYSFS=/sys/block/$DEV/queue
+export BENCH_DEV=/dev/$DEV BENCH_RUNTIME BENCH_BS BENCH_ENGINE
+
+if [ "$(cat "$SYSFS/zoned")" != host-managed ]; then
+	echo "$DEV is not a host-managed zoned device" >&2
+	exit 1
+fi
+for tool in fio blkzone dd blktrace blkparse; do
+	command -v $tool >/dev/null || { echo "$tool is required" >&2; exit 1; }
+done
+
+ZONE_SECTORS=$(cat "$SYSFS/chunk_sectors")
+ZONE_BYTES=$((ZONE_SECTORS * 512))
+NR_ZONES=$(cat "$SYSFS/nr_zones")
+MODEL=$(xargs < "/sys/block/$DEV/device/model" 2>/dev/null || echo unknown)
+FIRMWARE=$(xargs < "/sys/block/$DEV/device/firmware_rev" 2>/dev/null || echo unknown)
+mkdir -p "$RESULTS"
+
+set_scheduler() {
+	echo "$1" > "$SYSFS/scheduler"
+	grep -q "\[$1\]" "$SYSFS/scheduler" || { echo "cannot select $1 on $DEV" >&2; exit 1; }
+}
+
+reset_zones() {
+	blkzone reset "$BENCH_DEV"
+}
+
+# Reset (or finish) the storm zones, which follow the zones used by fio, until fio is done. Each
+# line in the log is an operation and its sector, in the order they are issued. The latencies
+# are taken from a blktrace of the run, see trace_start.
+storm() {
+	local op=$1 first=$2 log=$3 zone start
+
+	while :; do
+		for ((zone = first; zone < first + BENCH_STORM_ZONES; zone++)); do
+			[ -e "$log.stop" ] && return
+			start=$((zone * ZONE_SECTORS))
+			if [ "$op" = reset ]; then
+				dd if=/dev/zero of="$BENCH_DEV" bs=1M count="$BENCH_STORM_FILL_MB" \
+				   seek=$((start / 2048)) oflag=direct status=none
+			else
+				dd if=/dev/zero of="$BENCH_DEV" bs=1M count=1 \
+				   seek=$((start / 2048)) oflag=direct status=none
+			fi
+			echo "$op $start" >> "$log"
+			blkzone "$op" -o "$start" -c 1 "$BENCH_DEV"
+			if [ "$op" = finish ]; then
+				echo "reset $start" >> "$log"
+				blkzone reset -o "$start" -c 1 "$BENCH_DEV"
+			fi
+		done
+	done
+}
+
+# Trace queue, issue and completion events, so that the latencies of the management
+# operations are measured in the kernel rather than around the blkzone processes. bench/parse.py
+# takes the queue to completion (Q2C) and issue to completion (D2C) times from the trace.
+trace_start() {
+	local dir=$1
+
+	rm -rf "$dir"
+	mkdir -p "$dir"
+	blktrace -d "$BENCH_DEV" -a queue -a issue -a complete -D "$dir" >/dev/null &
+	trace_pid=$!
+	# blktrace needs a moment to set up its buffers
+	sleep 1
+}
+
+trace_stop() {
+	local dir=$1 out=$2
+
+	kill -INT "$trace_pid"
+	wait "$trace_pid" || true
+	blkparse -q -i "$DEV" -D "$dir" -f '%a %d %S %n %T.%9t\n' > "$out"
+	rm -rf "$dir"
+}
+
+# run <scheduler> <workload> <qd> <zones> <knob> <value>
+run() {
+	local sched=$1 workload=$2 qd=$3 zones=$4 knob=$5 value=$6
+	local tag="$sched-$workload-qd$qd-z$zones${knob:+-$knob-$value}"
+	local job=$workload storm_pid= trace_pid=
+
+	export BENCH_QD=$qd BENCH_ZONES=$zones BENCH_SIZE=$((zones * ZONE_BYTES))
+	if [ $((2 * zones + BENCH_STORM_ZONES)) -gt "$NR_ZONES" ]; then
+		echo "skipping $tag, $DEV has only $NR_ZONES zones" >&2
+		return
+	fi
+
+	echo "== $tag"
+	reset_zones
+	cat > "$RESULTS/$tag.meta" <<-EOF
+		drive=$MODEL
+		firmware=$FIRMWARE
+		scheduler=$sched
+		workload=$workload
+		qd=$qd
+		zones=$zones
+		knob=$knob
+		value=$value
+	EOF
+
+	case $workload in
+	mixed)
+		fio "$BENCH/jobs/prefill.fio" --output=/dev/null
+		;;
+	reset-storm|finish-storm)
+		job=write
+		rm -f "$RESULTS/$tag.storm" "$RESULTS/$tag.storm.stop" "$RESULTS/$tag.trace"
+		trace_start "$RESULTS/$tag.blktrace"
+		storm "${workload%-storm}" $((2 * zones)) "$RESULTS/$tag.storm" &
+		storm_pid=$!
+		;;
+	esac
+
+	fio "$BENCH/jobs/$job.fio" --output-format=json --output="$RESULTS/$tag.json"
+
+	if [ -n "$storm_pid" ]; then
+		touch "$RESULTS/$tag.storm.stop"
+		wait "$storm_pid"
+		rm -f "$RESULTS/$tag.storm.stop"
+		trace_stop "$RESULTS/$tag.blktrace" "$RESULTS/$tag.trace"
+	fi
+}
+
+run_all() {
+	local sched=$1 knob=$2 value=$3 workload qd zones
+
+	for workload in $BENCH_WORKLOADS; do
+		for qd in $BENCH_QDS; do
+			for zones in $BENCH_ZONE_COUNTS; do
+				run "$sched" "$workload" "$qd" "$zones" "$knob" "$value"
+			done
+		done
+	done
+}
+
+ORIG_SCHEDULER=$(sed 's/.*\[\(.*\)\].*/\1/' "$SYSFS/scheduler")
+trap 'set_scheduler "$ORIG_SCHEDULER"' EXIT
+
+for sched in $BENCH_SCHEDULERS; do
+	set_scheduler "$sched"
+	run_all "$sched" "" ""
+done
+
+# Knob sweeps, the knob is restored to its default after its sweep
+if [ -n "$BENCH_SWEEP" ]; then
+	set_scheduler zinc
+	for sweep in $BENCH_SWEEP; do
+		knob=${sweep%%=*}
+		if [ ! -w "$SYSFS/iosched/$knob" ]; then
+			echo "unknown ZINC knob $knob" >&2
+			exit 1
+		fi
+		default=$(cat "$SYSFS/iosched/$knob")
+		IFS=, read -ra values <<< "${sweep#*=}"
+		for value in "${values[@]}"; do
+			echo "$value" > "$SYSFS/iosched/$knob"
+			run_all zinc "$knob" "$value"
+		done
+		echo "$default" > "$SYSFS/iosched/$knob"
+	done
+fi
+
+reset_zones
+echo "results in $RESULTS, run $BENCH/parse.py $RESULTS for CSV"
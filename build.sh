@@ -2,6 +2,9 @@
 
 cp Makefile linux-6.4/block/
 cp zinc.c linux-6.4/block/
+cp zinc_trace.h linux-6.4/block/
+cp zinc_policy.h linux-6.4/block/
+cp zinc_ops.h linux-6.4/block/
 pushd linux-6.4/block/
 make
 
@@ -0,0 +1,777 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * zinc-replay: replay a blkparse trace through the ZINC policy core (zinc_policy.h) and a
+ * modeled ZNS device, to evaluate knob changes without a drive.
+ *
+ *   blkparse -i nvme0n2 | ./zinc-replay -o reset_command_tokens=4000 -o dev_units=16
+ *
+ * Only queue (Q) events are replayed, at their recorded time. Reads and writes are taken from
+ * the RWBS field. Requests without data direction (N) are zone appends when they carry data,
+ * and zone management requests when they do not: those become resets, or finishes with
+ * -o none_op=1, or are skipped with -o none_op=2.
+ *
+ * The scheduler is modeled after zinc.c for a single priority class (BE): reads are dispatched
+ * before writes, and the reset and finish queues are checked first whenever the device has a
+ * free slot, through the same policy core as the kernel. The device has dev_units parallel
+ * units, zone n is on unit n % dev_units, and every unit serves its requests one at a time in
+ * dispatch order, so a reset blocks the reads and writes of its unit while it runs. Resets take
+ * longer the fuller the zone is, finishes the emptier it is. Write pointers are tracked like
+ * zinc_track_write_pointer() does, zones that were not seen yet are full for the device and
+ * unknown for the policy.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../zinc_policy.h"
+
+#define NSEC_PER_USEC	1000ULL
+#define NSEC_PER_SEC	1000000000ULL
+#define SECTOR_SHIFT	9
+
+enum replay_op {
+	OP_READ,
+	OP_WRITE,
+	OP_RESET,
+	OP_FINISH,
+	NR_OPS,
+};
+
+static const char *const op_names[NR_OPS] = { "read", "write", "reset", "finish" };
+
+struct replay_rq {
+	u64 arrival;			// in ns
+	u64 end;			// in ns, once dispatched
+	u64 sector;
+	unsigned int bytes;
+	enum replay_op op;
+	unsigned int zone;
+	unsigned int epoch;		// management requests: epoch of the queue when queued
+	unsigned int charged;		// units charged at dispatch, see account_dispatch()
+	struct replay_rq *next;
+};
+
+struct replay_fifo {
+	struct replay_rq *head, *tail;
+	unsigned int nr;
+};
+
+/* One management queue, the counterpart of struct zinc_mgmt */
+struct replay_mgmt {
+	struct replay_fifo queue;
+	unsigned int epoch;
+	unsigned int batch_left;
+	bool timer_fired;
+	u64 next_timer;			// in ns
+	int dispatched_write, dispatched_read;
+	int pending_requests, pending_reads;
+	unsigned long cases[ZINC_NUM_CASES];
+
+	int command_tokens;
+	int maximum_epoch_holds;
+	int epoch_interval_us;
+	int minimum_concurrency_treshold;
+	int batch_size;
+	int read_command_tokens;
+	int minimum_read_concurrency_treshold;
+	int min_cost;
+};
+
+struct replay_hist {
+	u64 *lat;			// in ns
+	size_t nr, size;
+};
+
+static struct replay_mgmt reset_mgmt, finish_mgmt;
+static int write_cost[ZINC_COST_BUCKETS];
+
+/* Device model, in us unless noted otherwise */
+static int dev_units = 8;
+static int dev_depth = 64;		// requests in flight
+static int dev_read_us = 70;
+static int dev_read_unit_us = 4;	// per 8KiB
+static int dev_write_us = 15;
+static int dev_write_unit_us = 10;	// per 8KiB
+static int dev_reset_us = 5000;		// full zone
+static int dev_reset_min_us = 1000;	// empty zone
+static int dev_finish_us = 30000;	// empty zone
+static int dev_finish_min_us = 50;	// full zone
+static int zone_sectors = 2097152;	// 1GiB
+static int none_op;			// 0: reset, 1: finish, 2: skip
+static int csv;
+
+static struct replay_fifo reads, writes;
+static struct replay_rq **inflight;	// min-heap on end
+static int nr_inflight;
+static u64 *unit_busy;			// in ns
+static u32 *zone_wp;			// in sectors, ZONE_WP_UNKNOWN if not seen yet
+static unsigned int nr_zones;
+static struct replay_hist hist[NR_OPS];
+static u64 now;
+
+#define ZONE_WP_UNKNOWN	UINT32_MAX
+
+struct replay_knob {
+	const char *name;
+	int *value;
+	int min;
+};
+
+static const struct replay_knob knobs[] = {
+	{ "reset_command_tokens", &reset_mgmt.command_tokens, 0 },
+	{ "reset_maximum_epoch_holds", &reset_mgmt.maximum_epoch_holds, 0 },
+	{ "reset_epoch_interval_us", &reset_mgmt.epoch_interval_us, 10 },
+	{ "reset_minimum_concurrency_treshold", &reset_mgmt.minimum_concurrency_treshold, 0 },
+	{ "reset_batch_size", &reset_mgmt.batch_size, 1 },
+	{ "reset_read_command_tokens", &reset_mgmt.read_command_tokens, 0 },
+	{ "reset_minimum_read_concurrency_treshold", &reset_mgmt.minimum_read_concurrency_treshold, 0 },
+	{ "reset_min_cost", &reset_mgmt.min_cost, 0 },
+	{ "finish_command_tokens", &finish_mgmt.command_tokens, 0 },
+	{ "finish_maximum_epoch_holds", &finish_mgmt.maximum_epoch_holds, 0 },
+	{ "finish_epoch_interval_us", &finish_mgmt.epoch_interval_us, 10 },
+	{ "finish_minimum_concurrency_treshold", &finish_mgmt.minimum_concurrency_treshold, 0 },
+	{ "finish_batch_size", &finish_mgmt.batch_size, 1 },
+	{ "finish_read_command_tokens", &finish_mgmt.read_command_tokens, 0 },
+	{ "finish_minimum_read_concurrency_treshold", &finish_mgmt.minimum_read_concurrency_treshold, 0 },
+	{ "finish_min_cost", &finish_mgmt.min_cost, 0 },
+	{ "dev_units", &dev_units, 1 },
+	{ "dev_depth", &dev_depth, 1 },
+	{ "dev_read_us", &dev_read_us, 0 },
+	{ "dev_read_unit_us", &dev_read_unit_us, 0 },
+	{ "dev_write_us", &dev_write_us, 0 },
+	{ "dev_write_unit_us", &dev_write_unit_us, 0 },
+	{ "dev_reset_us", &dev_reset_us, 0 },
+	{ "dev_reset_min_us", &dev_reset_min_us, 0 },
+	{ "dev_finish_us", &dev_finish_us, 0 },
+	{ "dev_finish_min_us", &dev_finish_min_us, 0 },
+	{ "zone_sectors", &zone_sectors, 1 },
+	{ "none_op", &none_op, 0 },
+	{ NULL, NULL, 0 },
+};
+
+static void *xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (!ptr) {
+		perror("zinc-replay");
+		exit(1);
+	}
+	return ptr;
+}
+
+static void mgmt_init(struct replay_mgmt *zm, int command_tokens,
+		      int maximum_epoch_holds, int epoch_interval_ms,
+		      int minimum_concurrency_treshold, int batch_size)
+{
+	memset(zm, 0, sizeof(*zm));
+	zm->command_tokens = command_tokens;
+	zm->maximum_epoch_holds = maximum_epoch_holds;
+	zm->epoch_interval_us = epoch_interval_ms * 1000;
+	zm->minimum_concurrency_treshold = minimum_concurrency_treshold;
+	zm->batch_size = batch_size;
+	zm->min_cost = ZINC_COST_UNIT;
+}
+
+static int set_write_cost(const char *value)
+{
+	char *end;
+	int bucket;
+
+	for (bucket = 0; bucket < ZINC_COST_BUCKETS; bucket++) {
+		long weight = strtol(value, &end, 0);
+
+		if (end == value)
+			return -EINVAL;
+		if (weight < 1)
+			weight = 1;
+		else if (weight > ZINC_MAX_COST)
+			weight = ZINC_MAX_COST;
+		write_cost[bucket] = weight;
+		value = end + strspn(end, ", ");
+	}
+
+	return *value ? -EINVAL : 0;
+}
+
+static int set_knob(const char *arg)
+{
+	const char *eq = strchr(arg, '=');
+	const struct replay_knob *knob;
+	char *end;
+	long value;
+
+	if (!eq)
+		return -EINVAL;
+	if (eq - arg == strlen("write_cost_weights") &&
+	    !strncmp(arg, "write_cost_weights", eq - arg))
+		return set_write_cost(eq + 1);
+
+	for (knob = knobs; knob->name; knob++) {
+		if (strlen(knob->name) != (size_t)(eq - arg) ||
+		    strncmp(arg, knob->name, eq - arg))
+			continue;
+		value = strtol(eq + 1, &end, 0);
+		if (end == eq + 1 || *end)
+			return -EINVAL;
+		*knob->value = zinc_policy_clamp_int(value, knob->min);
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+static void fifo_push(struct replay_fifo *fifo, struct replay_rq *rq)
+{
+	rq->next = NULL;
+	if (fifo->tail)
+		fifo->tail->next = rq;
+	else
+		fifo->head = rq;
+	fifo->tail = rq;
+	fifo->nr++;
+}
+
+static struct replay_rq *fifo_pop(struct replay_fifo *fifo)
+{
+	struct replay_rq *rq = fifo->head;
+
+	if (!rq)
+		return NULL;
+	fifo->head = rq->next;
+	if (!fifo->head)
+		fifo->tail = NULL;
+	fifo->nr--;
+	return rq;
+}
+
+static void heap_push(struct replay_rq *rq)
+{
+	int i = nr_inflight++;
+
+	while (i && inflight[(i - 1) / 2]->end > rq->end) {
+		inflight[i] = inflight[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	inflight[i] = rq;
+}
+
+static struct replay_rq *heap_pop(void)
+{
+	struct replay_rq *top = inflight[0], *last = inflight[--nr_inflight];
+	int i = 0;
+
+	for (;;) {
+		int child = 2 * i + 1;
+
+		if (child >= nr_inflight)
+			break;
+		if (child + 1 < nr_inflight &&
+		    inflight[child + 1]->end < inflight[child]->end)
+			child++;
+		if (inflight[child]->end >= last->end)
+			break;
+		inflight[i] = inflight[child];
+		i = child;
+	}
+	inflight[i] = last;
+	return top;
+}
+
+static u32 *zone_wp_of(unsigned int zone)
+{
+	if (zone >= nr_zones) {
+		unsigned int nr = zone + 1 > 2 * nr_zones ? zone + 1 : 2 * nr_zones;
+
+		zone_wp = xrealloc(zone_wp, nr * sizeof(*zone_wp));
+		while (nr_zones < nr)
+			zone_wp[nr_zones++] = ZONE_WP_UNKNOWN;
+	}
+	return &zone_wp[zone];
+}
+
+/* fill of the zone of @rq in ZINC_COST_UNIT, -1 if unknown, see zinc_zone_fill() */
+static int zone_fill(struct replay_rq *rq)
+{
+	u32 wp = *zone_wp_of(rq->zone);
+
+	if (wp == ZONE_WP_UNKNOWN)
+		return -1;
+	return (u64)wp * ZINC_COST_UNIT / zone_sectors;
+}
+
+/* see zinc_track_write_pointer() */
+static void track_write_pointer(struct replay_rq *rq)
+{
+	u32 *wp = zone_wp_of(rq->zone);
+
+	switch (rq->op) {
+	case OP_WRITE:
+		*wp = rq->sector % zone_sectors + (rq->bytes >> SECTOR_SHIFT);
+		if (*wp > (u32)zone_sectors)
+			*wp = zone_sectors;
+		break;
+	case OP_RESET:
+		*wp = 0;
+		break;
+	case OP_FINISH:
+		*wp = zone_sectors;
+		break;
+	default:
+		break;
+	}
+}
+
+static u64 service_time(struct replay_rq *rq)
+{
+	unsigned int io_units = zinc_policy_io_units(rq->bytes);
+	int fill = zone_fill(rq);
+	u64 us;
+
+	if (fill < 0)
+		fill = ZINC_COST_UNIT;
+
+	switch (rq->op) {
+	case OP_READ:
+		us = dev_read_us + (u64)io_units * dev_read_unit_us;
+		break;
+	case OP_WRITE:
+		us = dev_write_us + (u64)io_units * dev_write_unit_us;
+		break;
+	case OP_RESET:
+		us = dev_reset_min_us +
+			(u64)(dev_reset_us - dev_reset_min_us) * fill / ZINC_COST_UNIT;
+		break;
+	default:
+		us = dev_finish_min_us +
+			(u64)(dev_finish_us - dev_finish_min_us) *
+			(ZINC_COST_UNIT - fill) / ZINC_COST_UNIT;
+		break;
+	}
+
+	return us * NSEC_PER_USEC;
+}
+
+static bool reads_tracked(struct replay_mgmt *zm)
+{
+	return zm->read_command_tokens || zm->minimum_read_concurrency_treshold;
+}
+
+/* see zinc_account_dispatch() */
+static void account_dispatch(struct replay_rq *rq)
+{
+	unsigned int io_units = zinc_policy_io_units(rq->bytes);
+
+	if (rq->op == OP_READ) {
+		if (!reads_tracked(&reset_mgmt) && !reads_tracked(&finish_mgmt))
+			return;
+		rq->charged = io_units;
+		reset_mgmt.dispatched_read += io_units;
+		finish_mgmt.dispatched_read += io_units;
+		reset_mgmt.pending_reads += io_units;
+		finish_mgmt.pending_reads += io_units;
+		return;
+	}
+	if (rq->op != OP_WRITE)
+		return;
+
+	rq->charged = zinc_policy_write_cost(write_cost, io_units);
+	reset_mgmt.dispatched_write += rq->charged;
+	finish_mgmt.dispatched_write += rq->charged;
+	reset_mgmt.pending_requests += rq->charged;
+	finish_mgmt.pending_requests += rq->charged;
+}
+
+/* see zinc_release_dispatch() */
+static void release_dispatch(struct replay_rq *rq)
+{
+	if (rq->op == OP_READ) {
+		reset_mgmt.pending_reads -= rq->charged;
+		finish_mgmt.pending_reads -= rq->charged;
+	} else if (rq->op == OP_WRITE) {
+		reset_mgmt.pending_requests -= rq->charged;
+		finish_mgmt.pending_requests -= rq->charged;
+	}
+	rq->charged = 0;
+}
+
+static bool mgmt_below_threshold(struct replay_mgmt *zm)
+{
+	return zinc_policy_idle(zm->pending_requests, zm->minimum_concurrency_treshold,
+				zm->pending_reads, zm->minimum_read_concurrency_treshold,
+				false);
+}
+
+static unsigned int mgmt_cost(struct replay_mgmt *zm, struct replay_rq *rq)
+{
+	return zinc_policy_cost(zm->min_cost, zone_fill(rq), zm == &finish_mgmt);
+}
+
+/* see zinc_mgmt_pick() and zinc_mgmt_dispatch() */
+static struct replay_rq *mgmt_dispatch(struct replay_mgmt *zm)
+{
+	const unsigned int prio = 1;	// BE
+	struct replay_rq *rq = zm->queue.head;
+	enum zinc_mgmt_case reason;
+	bool new_epoch = false;
+	unsigned int cost;
+
+	if (zm->timer_fired) {
+		zm->timer_fired = false;
+		zm->batch_left = zm->batch_size;
+		new_epoch = true;
+	}
+	if (!zm->batch_left)
+		return NULL;
+	if (!rq) {
+		zm->batch_left = 0;
+		return NULL;
+	}
+
+	cost = mgmt_cost(zm, rq);
+	reason = ZINC_CASE_IDLE;
+	if (mgmt_below_threshold(zm))
+		goto dispatch;
+	reason = ZINC_CASE_TOKENS;
+	if (zinc_policy_tokens(zm->dispatched_write, zm->command_tokens,
+			       zm->dispatched_read, zm->read_command_tokens,
+			       prio, cost))
+		goto dispatch;
+	reason = ZINC_CASE_HOLDS;
+	if (zinc_policy_held(zinc_policy_holds(zm->epoch, rq->epoch),
+			     zm->maximum_epoch_holds))
+		goto dispatch;
+
+	zm->cases[ZINC_CASE_POSTPONE]++;
+	zm->batch_left = 0;
+	if (new_epoch)
+		zm->epoch++;
+	return NULL;
+
+dispatch:
+	zm->cases[reason]++;
+	fifo_pop(&zm->queue);
+	zm->batch_left--;
+	zm->dispatched_write = zinc_policy_consume(zm->dispatched_write,
+		zinc_policy_cost_tokens(zm->command_tokens, prio, cost), zm->batch_size);
+	zm->dispatched_read = zinc_policy_consume(zm->dispatched_read,
+		zinc_policy_cost_tokens(zm->read_command_tokens, prio, cost), zm->batch_size);
+	return rq;
+}
+
+static void issue(struct replay_rq *rq)
+{
+	unsigned int unit = rq->zone % dev_units;
+	u64 start = unit_busy[unit] > now ? unit_busy[unit] : now;
+
+	account_dispatch(rq);
+	rq->end = start + service_time(rq);
+	track_write_pointer(rq);
+	unit_busy[unit] = rq->end;
+	heap_push(rq);
+}
+
+static void dispatch(void)
+{
+	struct replay_rq *rq;
+
+	while (nr_inflight < dev_depth) {
+		rq = mgmt_dispatch(&reset_mgmt);
+		if (!rq)
+			rq = mgmt_dispatch(&finish_mgmt);
+		if (!rq)
+			rq = fifo_pop(&reads);
+		if (!rq)
+			rq = fifo_pop(&writes);
+		if (!rq)
+			return;
+		issue(rq);
+	}
+}
+
+static void hist_add(struct replay_hist *h, u64 lat)
+{
+	if (h->nr == h->size) {
+		h->size = h->size ? 2 * h->size : 1024;
+		h->lat = xrealloc(h->lat, h->size * sizeof(*h->lat));
+	}
+	h->lat[h->nr++] = lat;
+}
+
+/* see dd_finish_request() */
+static void complete(struct replay_rq *rq)
+{
+	release_dispatch(rq);
+	hist_add(&hist[rq->op], rq->end - rq->arrival);
+	if (rq->op == OP_RESET && mgmt_below_threshold(&reset_mgmt))
+		reset_mgmt.timer_fired = true;
+	else if (rq->op == OP_FINISH && mgmt_below_threshold(&finish_mgmt))
+		finish_mgmt.timer_fired = true;
+	free(rq);
+}
+
+static void insert(struct replay_rq *rq)
+{
+	struct replay_mgmt *zm;
+
+	switch (rq->op) {
+	case OP_READ:
+		fifo_push(&reads, rq);
+		return;
+	case OP_WRITE:
+		fifo_push(&writes, rq);
+		return;
+	case OP_RESET:
+		zm = &reset_mgmt;
+		break;
+	default:
+		zm = &finish_mgmt;
+		break;
+	}
+
+	/* see zinc_mgmt_insert() */
+	rq->epoch = zm->epoch;
+	fifo_push(&zm->queue, rq);
+	if (mgmt_below_threshold(zm))
+		zm->timer_fired = true;
+}
+
+/*
+ * Fire the timer of @zm if its epoch ended by now, the epochs keep their phase. As in
+ * zinc_epoch_timer_fn(), an epoch only fires with requests queued, an epoch that ended while
+ * the queue was empty is only moved forward, see zinc_epoch_arm().
+ */
+static void mgmt_timer(struct replay_mgmt *zm)
+{
+	u64 interval = (u64)zm->epoch_interval_us * NSEC_PER_USEC;
+
+	if (now < zm->next_timer)
+		return;
+	if (zm->queue.nr)
+		zm->timer_fired = true;
+	zm->next_timer += ((now - zm->next_timer) / interval + 1) * interval;
+}
+
+/*
+ * Parse one line of the default blkparse output:
+ *   maj,min cpu seq time pid action rwbs sector + sectors [process]
+ */
+static struct replay_rq *parse_line(const char *line)
+{
+	char dev[32], action[8], rwbs[8];
+	unsigned long long sector = 0;
+	unsigned int sectors = 0, seq, cpu, pid;
+	struct replay_rq *rq;
+	const char *dir;
+	double time;
+	int n;
+
+	n = sscanf(line, "%31s %u %u %lf %u %7s %7s %llu + %u", dev, &cpu,
+		   &seq, &time, &pid, action, rwbs, &sector, &sectors);
+	if (n < 8 || strcmp(action, "Q"))
+		return NULL;
+
+	rq = calloc(1, sizeof(*rq));
+	if (!rq) {
+		perror("zinc-replay");
+		exit(1);
+	}
+	rq->arrival = time * NSEC_PER_SEC;
+	rq->sector = sector;
+	rq->bytes = sectors << SECTOR_SHIFT;
+	rq->zone = sector / zone_sectors;
+
+	/* a leading F is a preflush, the data direction follows */
+	dir = rwbs[0] == 'F' && rwbs[1] ? rwbs + 1 : rwbs;
+	switch (*dir) {
+	case 'R':
+		rq->op = OP_READ;
+		return rq;
+	case 'W':
+		rq->op = OP_WRITE;
+		return rq;
+	case 'N':
+		/* blktrace shows zone appends as N as well, they are writes for ZINC */
+		if (sectors) {
+			rq->op = OP_WRITE;
+			return rq;
+		}
+		if (none_op == 0) {
+			rq->op = OP_RESET;
+			return rq;
+		}
+		if (none_op == 1) {
+			rq->op = OP_FINISH;
+			return rq;
+		}
+		break;
+	}
+
+	free(rq);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(struct replay_hist *h, unsigned int pct)
+{
+	size_t i;
+
+	if (!h->nr)
+		return 0;
+	i = (h->nr * pct + 99) / 100;
+	return h->lat[i ? i - 1 : 0] / (double)NSEC_PER_USEC;
+}
+
+static void report(u64 first, u64 last)
+{
+	enum replay_op op;
+	int c;
+
+	for (op = 0; op < NR_OPS; op++)
+		qsort(hist[op].lat, hist[op].nr, sizeof(u64), cmp_u64);
+
+	if (csv) {
+		printf("op,count,p50_us,p99_us,max_us\n");
+		for (op = 0; op < NR_OPS; op++)
+			printf("%s,%zu,%.1f,%.1f,%.1f\n", op_names[op],
+			       hist[op].nr, percentile_us(&hist[op], 50),
+			       percentile_us(&hist[op], 99),
+			       percentile_us(&hist[op], 100));
+		return;
+	}
+
+	printf("replayed %.3f s of trace in %.3f s of device time\n",
+	       (last - first) / (double)NSEC_PER_SEC,
+	       (now - first) / (double)NSEC_PER_SEC);
+	printf("%-8s %10s %12s %12s %12s\n", "op", "count", "p50 (us)",
+	       "p99 (us)", "max (us)");
+	for (op = 0; op < NR_OPS; op++)
+		printf("%-8s %10zu %12.1f %12.1f %12.1f\n", op_names[op],
+		       hist[op].nr, percentile_us(&hist[op], 50),
+		       percentile_us(&hist[op], 99),
+		       percentile_us(&hist[op], 100));
+	for (c = 0; c < 2; c++) {
+		struct replay_mgmt *zm = c ? &finish_mgmt : &reset_mgmt;
+
+		printf("%s decisions: idle %lu tokens %lu holds %lu postpone %lu\n",
+		       c ? "finish" : "reset", zm->cases[ZINC_CASE_IDLE],
+		       zm->cases[ZINC_CASE_TOKENS], zm->cases[ZINC_CASE_HOLDS],
+		       zm->cases[ZINC_CASE_POSTPONE]);
+	}
+}
+
+static void usage(void)
+{
+	const struct replay_knob *knob;
+
+	fprintf(stderr, "usage: blkparse -i <trace> | zinc-replay [-c] [-o knob=value]... [file]\n"
+		"  -c  print the latencies as CSV\n"
+		"  -o  set a knob, the ZINC knobs have the names of the sysfs attributes:\n"
+		"      write_cost_weights=w0,...,w7\n");
+	for (knob = knobs; knob->name; knob++)
+		fprintf(stderr, "      %s=%d\n", knob->name, *knob->value);
+}
+
+int main(int argc, char **argv)
+{
+	struct replay_rq *pending = NULL;
+	bool first_seen = false;
+	u64 first = 0, last = 0;
+	char line[512];
+	FILE *in = stdin;
+	int bucket, opt;
+
+	mgmt_init(&reset_mgmt, RESET_COMMAND_TOKENS, RESET_MAXIMUM_EPOCH_HOLDS,
+		  RESET_EPOCH_INTERVAL, RESET_MINIMUM_CONCURRENCY_THRESHOLD,
+		  RESET_BATCH_SIZE);
+	mgmt_init(&finish_mgmt, FINISH_COMMAND_TOKENS, FINISH_MAXIMUM_EPOCH_HOLDS,
+		  FINISH_EPOCH_INTERVAL, FINISH_MINIMUM_CONCURRENCY_THRESHOLD,
+		  FINISH_BATCH_SIZE);
+	for (bucket = 0; bucket < ZINC_COST_BUCKETS; bucket++)
+		write_cost[bucket] = ZINC_COST_UNIT;
+
+	while ((opt = getopt(argc, argv, "co:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			csv = 1;
+			break;
+		case 'o':
+			if (set_knob(optarg)) {
+				fprintf(stderr, "zinc-replay: invalid knob %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage();
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (optind < argc) {
+		in = fopen(argv[optind], "r");
+		if (!in) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	inflight = xrealloc(NULL, dev_depth * sizeof(*inflight));
+	unit_busy = calloc(dev_units, sizeof(*unit_busy));
+	if (!unit_busy) {
+		perror("zinc-replay");
+		return 1;
+	}
+
+	for (;;) {
+		u64 next = UINT64_MAX;
+
+		while (!pending && fgets(line, sizeof(line), in)) {
+			pending = parse_line(line);
+			if (pending && !first_seen) {
+				first = pending->arrival;
+				reset_mgmt.next_timer = first +
+					(u64)reset_mgmt.epoch_interval_us * NSEC_PER_USEC;
+				finish_mgmt.next_timer = first +
+					(u64)finish_mgmt.epoch_interval_us * NSEC_PER_USEC;
+				first_seen = true;
+			}
+		}
+
+		if (pending)
+			next = pending->arrival;
+		if (nr_inflight && inflight[0]->end < next)
+			next = inflight[0]->end;
+		if (reset_mgmt.queue.nr && reset_mgmt.next_timer < next)
+			next = reset_mgmt.next_timer;
+		if (finish_mgmt.queue.nr && finish_mgmt.next_timer < next)
+			next = finish_mgmt.next_timer;
+		if (next == UINT64_MAX)
+			break;
+		if (next > now)
+			now = next;
+
+		mgmt_timer(&reset_mgmt);
+		mgmt_timer(&finish_mgmt);
+		while (nr_inflight && inflight[0]->end <= now)
+			complete(heap_pop());
+		if (pending && pending->arrival <= now) {
+			last = pending->arrival;
+			insert(pending);
+			pending = NULL;
+		}
+		dispatch();
+	}
+
+	if (!first_seen) {
+		fprintf(stderr, "zinc-replay: no queue events in the trace\n");
+		return 1;
+	}
+	report(first, last);
+	return 0;
+}
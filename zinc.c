@@ -17,6 +17,10 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 #include <linux/sbitmap.h>
+#include <linux/xarray.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
 
 #include <trace/events/block.h>
 
@@ -25,31 +29,34 @@
 #include "blk-mq.h"
 #include "blk-mq-debugfs.h"
 #include "blk-mq-sched.h"
+#include "blk-stat.h"
+#include "zinc_policy.h"
+#include "zinc_ops.h"
 
- /*
- * WARNING (ZINC)
- * 1. Only a single queue for all reset requests and a single queue for all finish requests
- * 2. This scheduler currently does not support APPEND requests. 
+#define CREATE_TRACE_POINTS
+#include "zinc_trace.h"
+
+/*
+ * ZINC adaptive controller, see zinc_adapt_update()
  */
+static const int ZINC_ADAPT_WINDOW = 100;	// In ms, interval at which the write latency is evaluated
+static const int ZINC_ADAPT_MIN_SAMPLES = 16;	// Minimum number of completed writes for a decision
 
 /*
- * Default ZINC parameters
+ * ZINC zone groups, see zinc_zone_group()
  */
-static const int RESET_EPOCH_INTERVAL = 64;	// In ms
-static const int RESET_COMMAND_TOKENS = 2000; // 
-static const int RESET_MINIMUM_CONCURRENCY_THRESHOLD = 3; // In number of resets 
-static const int RESET_MAXIMUM_EPOCH_HOLDS = 3; // In number of retries
+#define ZINC_MAX_ZONE_GROUPS	256
+static const int ZINC_MGMT_SCAN_DEPTH = 8;	// Queued requests considered when looking for an idle zone group
 
-static const int FINISH_EPOCH_INTERVAL = 64;	// In ms
-static const int FINISH_COMMAND_TOKENS = 2000; // 
-static const int FINISH_MINIMUM_CONCURRENCY_THRESHOLD = 3; // In number of resets 
-static const int FINISH_MAXIMUM_EPOCH_HOLDS = 3; // In number of retries
+/*
+ * ZINC cost model, see zinc_policy.h
+ */
+static const u32 ZINC_WP_UNKNOWN = U32_MAX;	// write pointer of a zone ZINC has not seen yet
 
 /*
- *  I/O Unit conversions
+ * ZINC share groups, see struct zinc_share
  */
-static const int ZINC_IO_SIZE_BIT_SHIFT = 13;	// We keep track of I/O sizes in 8KiB units 
-static const int ZINC_IO_SIZE_SECTOR_SHIFT = 4;	// We keep track of I/O sizes in 8KiB
+static const int ZINC_SHARE_CONTROLLER = -1;	// share_group of the queues grouped by controller
 
 /*
  * See Documentation/block/deadline-iosched.rst
@@ -71,12 +78,15 @@ enum dd_data_dir {
     ZINC_APPEND,
 	ZINC_FINISH,
 	ZINC_RESET,
+	ZINC_RESET_ALL,		// issued only when no writes are in flight
+	ZINC_OPEN_CLOSE,	// cheap, never held back
 	ZINC_OTHER,
 	ZINC_NUM_DIR,
 };
 
 #define DD_READ ZINC_READ
 #define DD_WRITE ZINC_WRITE
+#define DD_APPEND ZINC_APPEND
 
 static inline enum dd_data_dir zinc_data_dir(struct request *rq)
 {
@@ -86,19 +96,55 @@ static inline enum dd_data_dir zinc_data_dir(struct request *rq)
 			return ZINC_READ;
 		case REQ_OP_WRITE:
 			return ZINC_WRITE;
+		case REQ_OP_ZONE_APPEND:
+			return ZINC_APPEND;
 		case REQ_OP_ZONE_RESET:
 			// pr_alert("Reset\n");
 			return ZINC_RESET;
 		case REQ_OP_ZONE_FINISH:
 			// pr_alert("Finish\n");
 			return ZINC_FINISH;
+		case REQ_OP_ZONE_RESET_ALL:
+			return ZINC_RESET_ALL;
+		case REQ_OP_ZONE_OPEN:
+		case REQ_OP_ZONE_CLOSE:
+			return ZINC_OPEN_CLOSE;
 		default:
 			// pr_alert("Other\n");
 			return ZINC_OTHER;
 	}
 }
 
-enum { DD_DIR_COUNT = 2 };
+enum { DD_DIR_COUNT = 3 };
+
+/* ZINC
+ * Zone append requests are writes for the interference accounting, but the device picks
+ * the write location, so they never need the zone write lock.
+ */
+static inline bool zinc_is_write_dir(enum dd_data_dir data_dir)
+{
+	return data_dir == ZINC_WRITE || data_dir == ZINC_APPEND;
+}
+
+/* ZINC: requests queued on the reset queue, other unknown operations are gated like a reset */
+static inline bool zinc_is_reset_dir(enum dd_data_dir data_dir)
+{
+	return data_dir == ZINC_RESET || data_dir == ZINC_RESET_ALL ||
+		data_dir == ZINC_OTHER;
+}
+
+/* ZINC: resets and finishes, which are held back in the management queues */
+static inline bool zinc_op_is_mgmt(blk_opf_t opf)
+{
+	switch (opf & REQ_OP_MASK) {
+	case REQ_OP_ZONE_RESET:
+	case REQ_OP_ZONE_RESET_ALL:
+	case REQ_OP_ZONE_FINISH:
+		return true;
+	default:
+		return false;
+	}
+}
 
 enum dd_prio {
 	DD_RT_PRIO	= 0,
@@ -108,6 +154,49 @@ enum dd_prio {
 };
 
 enum { DD_PRIO_COUNT = 3 };
+static_assert(DD_PRIO_COUNT == ZINC_POLICY_PRIOS);
+
+/*
+ * ZINC adaptive controller
+ * Write latencies are sampled in buckets relative to the target latency. The first
+ * ZINC_LAT_GOOD_BUCKETS buckets cover latencies below the target, the remaining ones
+ * cover latencies above it (the last bucket collects everything beyond).
+ * Command tokens and epoch intervals are scaled by adapt_scale / ZINC_ADAPT_SCALE_UNIT.
+ */
+enum {
+	ZINC_LAT_GOOD_BUCKETS	= 4,
+	ZINC_LAT_BUCKETS	= 8,
+};
+
+enum {
+	ZINC_ADAPT_SCALE_MIN	= ZINC_ADAPT_SCALE_UNIT / 4,
+	ZINC_ADAPT_SCALE_MAX	= ZINC_ADAPT_SCALE_UNIT * 16,
+};
+
+struct zinc_adapt {
+	atomic_t latency_buckets[ZINC_LAT_BUCKETS];
+	unsigned long window_end;	// in jiffies
+};
+
+/*
+ * ZINC latency histograms, exported in debugfs. Bucket i counts latencies below 2^i us, the
+ * last bucket collects everything beyond. The queue wait is measured from the allocation of
+ * a request until it is issued to the device, the service time from issue until completion.
+ */
+enum zinc_hist_op {
+	ZINC_HIST_READ,
+	ZINC_HIST_WRITE,
+	ZINC_HIST_RESET,
+	ZINC_HIST_FINISH,
+	ZINC_HIST_OPS,
+};
+
+enum { ZINC_HIST_BUCKETS = 24 };
+
+struct zinc_hist {
+	atomic_t wait[ZINC_HIST_OPS][ZINC_HIST_BUCKETS];
+	atomic_t service[ZINC_HIST_OPS][ZINC_HIST_BUCKETS];
+};
 
 /*
  * I/O statistics per I/O priority. It is fine if these counters overflow.
@@ -132,86 +221,1483 @@ struct dd_per_prio {
 	/* Next request in FIFO order. Read, write or both are NULL. */
 	struct request *next_rq[DD_DIR_COUNT];
 	struct io_stats_per_prio stats;
+	/* ZINC: zones with queued writes on sort_list[DD_WRITE], see zinc_next_write() */
+	unsigned long *write_zones;
+};
+
+/*
+ * ZINC management queue of one I/O priority.
+ *
+ * Requests are kept in arrival order on @queue and indexed by zone number in @zones. The index
+ * points to the oldest queued request of a zone, younger requests for the same zone are chained
+ * through zinc_rq->next. Instead of incrementing a hold counter in every queued request each
+ * time an epoch is postponed, @epoch is incremented and each request remembers in zinc_rq->epoch
+ * the epoch at which it was queued. The number of epoch holds of a request is the difference.
+ *
+ * Only the reads and writes of the same priority earn command tokens for its requests.
+ */
+struct zinc_mgmt_prio {
+	struct list_head queue;		// management requests in arrival order
+	struct xarray zones;		// zone number -> oldest queued request of that zone
+	struct request *reset_all;	// oldest queued reset of all zones, if any
+	struct list_head urgent;	// queued requests with REQ_PRIO in arrival order
+	unsigned int nr_urgent;		// number of requests on @urgent
+	unsigned int epoch;		// number of postponed epochs
+
+	atomic_t dispatched_write;      // number of dispatched write requests in 8KiB units
+	atomic_t dispatched_read;	// number of dispatched read requests in 8KiB units
+};
+
+/*
+ * ZINC management queue, there is one for reset requests and one for finish requests.
+ * Queued requests are split per I/O priority, see struct zinc_mgmt_prio. The concurrency
+ * thresholds, the timer and the batch are shared by all priorities.
+ */
+struct zinc_mgmt {
+	struct zinc_mgmt_prio per_prio[DD_PRIO_COUNT];
+	unsigned int nr_queued;
+	unsigned int batch_left;	// requests that can still be issued in this epoch
+	unsigned long cases[ZINC_NUM_CASES];	// number of decisions per case, for debugfs
+	unsigned long coalesced;	// requests completed with a queued reset, see zinc_mgmt_coalesce()
+	atomic_t idle_fired;		// an idle window opened, see zinc_mgmt_idle_pick()
+	unsigned int idle_left;		// requests that can still be issued in the idle window
+	unsigned long idle_issued;	// requests issued in idle windows, for debugfs
+	atomic_t inflight;		// issued requests that did not complete yet
+	u64 bucket;			// rate mode tokens, see zinc_mgmt_bucket_refill()
+	u64 bucket_time;		// time of the last refill in ns
+
+	atomic_t pending_requests;    	// number of in-flight pending write request in 8KiB units (larger requests are divided into this unit)
+	atomic_t pending_reads;		// number of in-flight read requests in 8KiB units
+
+	// ZINC Parameters
+	int command_tokens;
+	int maximum_epoch_holds;
+	int epoch_interval_us;     	// in us
+	int minimum_concurrency_treshold; // threshold of the maximum number of pending requests in 8KiB units
+	int batch_size;			// maximum number of requests issued per epoch
+	int read_command_tokens;	// read units that allow issuing a request, 0 disables read tokens
+	int minimum_read_concurrency_treshold; // threshold of in-flight reads in 8KiB units, 0 ignores reads
+	int adapt_scale;		// scale of command tokens and epoch interval, see struct zinc_adapt
+	int min_cost;			// cost in percent of a request on a zone in its cheapest state, see zinc_mgmt_cost()
+	int urgent;			// hint: all requests are urgent, see zinc_mgmt_urgent_pick()
+	int urgent_queue_depth;		// all requests are urgent from this number of queued requests, 0 disables it
+	int urgent_epoch_holds;		// epochs an urgent request is held back
+	int max_inflight;		// maximum number of issued requests in flight, 0 for no limit
+	int rate;			// rate mode: operations per second, 0 disables it
+	int rate_burst;			// rate mode: operations the bucket holds
+	int rate_writes;		// rate mode: command tokens are needed as well
+
+	// ZINC epochs, see zinc_epoch_timer_fn()
+	atomic_t timer_fired;
+	ktime_t next_epoch;		// end of the current epoch
+	struct deadline_data *dd;
+	const char *name;		// for tracing
+};
+
+/*
+ * ZINC share group: queues on the same flash, for instance the namespaces of one ZNS drive.
+ * The management requests of every member wait for the in-flight writes and earn the command
+ * tokens of all members. Members are grouped by an explicit id or by their controller (the
+ * parent device of their disk), see deadline_share_group_store().
+ */
+struct zinc_share {
+	struct list_head node;		// in zinc_shares
+	struct device *controller;	// only set for ZINC_SHARE_CONTROLLER
+	int id;
+	int members;			// protected by zinc_shares_lock
+	atomic_t pending_requests;	// in-flight writes of all members in 8KiB units
+	atomic_t dispatched_write[2][DD_PRIO_COUNT];	// write tokens of the resets and the finishes
+	struct rcu_head rcu;
 };
 
+static LIST_HEAD(zinc_shares);
+static DEFINE_MUTEX(zinc_shares_lock);
+
+/* ZINC registered policies, see zinc_ops.h */
+static LIST_HEAD(zinc_policies);
+static DEFINE_MUTEX(zinc_policies_lock);
+
 struct deadline_data {
 	// ZINC deadline data
-	struct list_head reset_queue; 	// queue for reset requests
-	struct list_head finish_queue; 	// queue for finish requests
+	struct zinc_mgmt reset;
+	struct zinc_mgmt finish;
 
-	atomic_t reset_pending_requests;    	// number of in-flight pending write request in 8KiB units (larger requests are divided into this unit)
-	atomic_t finish_pending_requests;    	// number of in-flight pending write request in 8KiB units (larger requests are divided into this unit)
-	atomic_t reset_dispatched_write;      // number of dispatched write requests in 8KiB units
-	atomic_t finish_dispatched_write;      // number of dispatched write requests in 8KiB units
+	struct request_queue *queue;
+	int target_write_latency_us;	// write p99 target of the adaptive controller, 0 disables it
+	struct zinc_adapt adapt;
+	struct zinc_hist hist;
+	int read_staging;		// stage reads per hardware queue, see struct zinc_hctx
+	int read_passthrough;		// pass RT and BE reads through a lock-free queue, see struct zinc_hctx
+	int mgmt_coalesce;		// coalesce management requests of the same zone, see zinc_mgmt_coalesce()
 
-	// ZINC Parameters
-	int reset_command_tokens;
-	int reset_maximum_epoch_holds;
-	int reset_epoch_interval;     	// in jiffies
-	int reset_minimum_concurrency_treshold; // threshold of the maximum number of pending requests in 8KiB units
+	/*
+	 * ZINC zone groups: zones that share parallel units are in the same group. In-flight
+	 * writes are tracked per group, so that management requests only wait for the writes of
+	 * the group of their zone.
+	 */
+	int zone_groups;
+	atomic_t group_pending_requests[ZINC_MAX_ZONE_GROUPS];	// in-flight writes in 8KiB units
+	unsigned int nr_write_zones;	// number of bits of dd_per_prio->write_zones
+	int write_striping;		// round-robin writes over zones, see zinc_stripe_write()
+	unsigned int write_cursor;	// zone of the last dispatched write
+	int idle_grace_us;		// write idle time before an idle window opens, 0 disables them
+	struct hrtimer epoch_timer;	// epochs of both management queues, see zinc_epoch_timer_fn()
+	atomic_t epoch_armed;		// epoch_timer is owned by a CPU, see zinc_epoch_arm()
+	struct hrtimer idle_timer;	// see zinc_idle_arm()
+	int write_plug_us;		// time a zone is plugged for contiguous writes, 0 disables it
+	struct hrtimer plug_timer;	// runs the queue when a plug window ends
+	int share_group;		// 0 if this queue does not share its state
+	struct zinc_share *share;	// only changed with dd->lock held and no write in flight
+	struct zinc_policy_ops __rcu *policy;	// selected policy, NULL for the built-in one
+
+	/* ZINC cost model, see zinc_policy_write_cost() and zinc_track_write_pointer() */
+	int write_cost[ZINC_COST_BUCKETS];	// weight in percent of a write per size bucket
+	u32 *zone_wp;			// estimated write pointer per zone, in sectors from the zone start
+	unsigned int nr_zones;		// number of entries of zone_wp
+
+	/*
+	 * MQ run time data
+	 */
+
+	struct dd_per_prio per_prio[DD_PRIO_COUNT];
+
+	/* MQ Data direction of latest dispatched request. */
+	enum dd_data_dir last_dir;
+	unsigned int batching;		/* number of sequential requests made */
+	unsigned int starved;		/* times reads have starved writes */
+
+	/*
+	 * MQ settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[DD_DIR_COUNT];
+	int fifo_batch;
+	int writes_starved;
+	int front_merges;
+	u32 async_depth;
+	int mgmt_depth;		// ZINC: tags usable by resets and finishes, 0 for async_depth
+	int prio_aging_expire;
+
+	spinlock_t lock;
+	spinlock_t zone_lock;
+};
+
+/*
+ * ZINC per hardware queue data.
+ * With read_staging enabled, reads do not enter the sort and FIFO lists. Reads never need a
+ * zone write lock, so they are staged per hardware queue and dispatched under the hardware
+ * queue lock only, and the global lock is left to zoned writes and the management queues.
+ * Staged reads are not part of the per priority statistics (dd_queued()).
+ *
+ * With read_passthrough enabled, RT and BE reads are not even staged at insertion. They are
+ * pushed on @passthrough, a lock-free multi-producer stack linked through rq->rq_next. The
+ * dispatcher takes the whole stack at once, dispatches the oldest read directly and stages
+ * the remaining ones in arrival order.
+ */
+struct zinc_hctx {
+	spinlock_t lock;
+	struct list_head reads[DD_PRIO_COUNT];
+	unsigned int batching;		// staged reads dispatched since the global queues were checked
+	struct request *passthrough;	// lock-free stack of passthrough reads, newest first
+
+	struct zinc_rq *rqs;		// per request data, indexed by scheduler tag
+	unsigned int nr_rqs;
+};
+
+/*
+ * ZINC per request data. It is preallocated for every scheduler tag of a hardware queue, so
+ * that no request field has to be overloaded and nothing is allocated on the hot path. It is
+ * cleared in dd_prepare_request().
+ */
+struct zinc_rq {
+	unsigned int state;		// ZINC_RQ_*, 0 if the request bypassed the scheduler
+	unsigned int epoch;		// management requests: epoch of the queue when queued
+	unsigned int charged;		// units charged to the pending reads or writes at dispatch
+	unsigned int group;		// writes: charged zone group plus one, 0 if none
+	bool charged_read;		// the charged units are reads
+	bool mgmt_inflight;		// management requests: counted in zinc_mgmt->inflight
+	u64 plug_start;			// writes: insert time in ns if plugged, see zinc_write_plugged()
+	struct list_head urgent;	// management requests with REQ_PRIO: in zinc_mgmt_prio->urgent
+	struct request *rq;		// the request, for the entries of zinc_mgmt_prio->urgent
+	struct request *next;		// management requests: next queued request of the same
+					// zone, or next coalesced request once dequeued
+};
+
+static inline struct zinc_rq *zinc_rq(struct request *rq)
+{
+	struct zinc_hctx *zh = rq->mq_hctx->sched_data;
+
+	return &zh->rqs[rq->internal_tag];
+}
+
+/* Values of zinc_rq->state */
+enum {
+	ZINC_RQ_INSERTED	= 1,	// inserted in the sort and FIFO lists
+	ZINC_RQ_STAGED		= 2,	// staged in struct zinc_hctx
+	ZINC_RQ_MGMT		= 3,	// queued in struct zinc_mgmt
+};
+
+/* Maps an I/O priority class to a deadline scheduler priority. */
+static const enum dd_prio ioprio_class_to_prio[] = {
+	[IOPRIO_CLASS_NONE]	= DD_BE_PRIO,
+	[IOPRIO_CLASS_RT]	= DD_RT_PRIO,
+	[IOPRIO_CLASS_BE]	= DD_BE_PRIO,
+	[IOPRIO_CLASS_IDLE]	= DD_IDLE_PRIO,
+};
+
+/* ZINC: the command tokens, scaled by the adaptive controller */
+static inline int zinc_mgmt_command_tokens(struct zinc_mgmt *zm)
+{
+	return zinc_policy_scale(zm->command_tokens, READ_ONCE(zm->adapt_scale));
+}
+
+static inline bool zinc_mgmt_queued(struct zinc_mgmt *zm)
+{
+	return READ_ONCE(zm->nr_queued) != 0;
+}
+
+/* ZINC: management queue of the reset or finish @rq */
+static inline struct zinc_mgmt *zinc_rq_mgmt(struct deadline_data *dd,
+					     struct request *rq)
+{
+	return zinc_data_dir(rq) == ZINC_FINISH ? &dd->finish : &dd->reset;
+}
+
+/* ZINC: in-flight writes in 8KiB units, of all members of the share group if there is one */
+static int zinc_pending_writes(struct deadline_data *dd)
+{
+	struct zinc_share *share;
+	int pending;
+
+	rcu_read_lock();
+	share = READ_ONCE(dd->share);
+	pending = atomic_read(share ? &share->pending_requests :
+			      &dd->reset.pending_requests);
+	rcu_read_unlock();
+
+	return pending;
+}
+
+/* ZINC: write tokens of the management requests of @zm and priority @prio */
+static inline atomic_t *zinc_mgmt_write_tokens(struct zinc_mgmt *zm,
+					       enum dd_prio prio)
+{
+	struct zinc_share *share = zm->dd->share;
+
+	if (share)
+		return &share->dispatched_write[zm == &zm->dd->finish][prio];
+	return &zm->per_prio[prio].dispatched_write;
+}
+
+static struct zinc_share *zinc_share_get(struct device *controller, int id)
+{
+	struct zinc_share *share;
+
+	lockdep_assert_held(&zinc_shares_lock);
+
+	list_for_each_entry(share, &zinc_shares, node) {
+		if (share->controller == controller && share->id == id) {
+			share->members++;
+			return share;
+		}
+	}
+
+	share = kzalloc(sizeof(*share), GFP_KERNEL);
+	if (!share)
+		return NULL;
+	share->controller = controller;
+	share->id = id;
+	share->members = 1;
+	list_add(&share->node, &zinc_shares);
+	return share;
+}
+
+static struct zinc_policy_ops *zinc_ops_find(const char *name)
+{
+	struct zinc_policy_ops *ops;
+
+	lockdep_assert_held(&zinc_policies_lock);
+
+	list_for_each_entry(ops, &zinc_policies, list)
+		if (!strcmp(ops->name, name))
+			return ops;
+	return NULL;
+}
+
+int zinc_register_policy(struct zinc_policy_ops *ops)
+{
+	int ret = 0;
+
+	if (!ops->name || !*ops->name || strlen(ops->name) >= ZINC_POLICY_NAME_MAX ||
+	    !strcmp(ops->name, "default"))
+		return -EINVAL;
+
+	mutex_lock(&zinc_policies_lock);
+	if (zinc_ops_find(ops->name))
+		ret = -EEXIST;
+	else
+		list_add_tail(&ops->list, &zinc_policies);
+	mutex_unlock(&zinc_policies_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(zinc_register_policy);
+
+/* A selected policy holds a reference on its owner, so it is not in use anymore */
+void zinc_unregister_policy(struct zinc_policy_ops *ops)
+{
+	mutex_lock(&zinc_policies_lock);
+	list_del_init(&ops->list);
+	mutex_unlock(&zinc_policies_lock);
+}
+EXPORT_SYMBOL_GPL(zinc_unregister_policy);
+
+/* ZINC: call @hook of the selected policy, if any */
+#define zinc_ops_call(dd, hook, ...)					\
+do {									\
+	struct zinc_policy_ops *__ops;					\
+									\
+	rcu_read_lock();						\
+	__ops = rcu_dereference((dd)->policy);				\
+	if (__ops && __ops->hook)					\
+		__ops->hook((dd)->queue, ##__VA_ARGS__);		\
+	rcu_read_unlock();						\
+} while (0)
+
+/* Lockless readers of the in-flight writes may still use the share, see zinc_pending_writes() */
+static void zinc_share_put(struct zinc_share *share)
+{
+	lockdep_assert_held(&zinc_shares_lock);
+
+	if (!share || --share->members)
+		return;
+	list_del(&share->node);
+	kfree_rcu(share, rcu);
+}
+
+static inline ktime_t zinc_mgmt_epoch_interval(struct zinc_mgmt *zm)
+{
+	u64 interval = (u64)READ_ONCE(zm->epoch_interval_us) *
+		READ_ONCE(zm->adapt_scale);
+
+	return us_to_ktime(max_t(u64, interval >> ZINC_ADAPT_SCALE_SHIFT,
+				 ZINC_MIN_EPOCH_INTERVAL));
+}
+
+/* ZINC timers
+ * When the timer is fired, we set the timer-fired flag to true. This is not protected by lock,
+ * even if there is a race condition, we only miss a reset dispatch, protected it by a timer
+ * will serialized the timer with the insert/dispatch function. MIGHT CAUSE A DEADLOCK.
+ * The epochs are hrtimer based, so that they can be shorter than a jiffy.
+ *
+ * Both queues share a single timer per device, which only runs while management requests are
+ * queued. Each queue keeps the end of its epoch in next_epoch, which only moves forward in
+ * whole epoch intervals, so that the epochs keep their phase while the timer is not armed.
+ */
+
+/* Move the epoch of @zm past @now, returns true if an epoch ended */
+static bool zinc_epoch_forward(struct zinc_mgmt *zm, ktime_t now)
+{
+	s64 interval = ktime_to_ns(zinc_mgmt_epoch_interval(zm));
+	s64 late = ktime_to_ns(ktime_sub(now, zm->next_epoch));
+
+	if (late < 0)
+		return false;
+
+	zm->next_epoch = ktime_add_ns(zm->next_epoch,
+				      (div64_s64(late, interval) + 1) * interval);
+	return true;
+}
+
+static inline ktime_t zinc_epoch_next(struct deadline_data *dd)
+{
+	return ktime_before(dd->reset.next_epoch, dd->finish.next_epoch) ?
+		dd->reset.next_epoch : dd->finish.next_epoch;
+}
+
+static inline bool zinc_mgmt_any_queued(struct deadline_data *dd)
+{
+	return zinc_mgmt_queued(&dd->reset) || zinc_mgmt_queued(&dd->finish);
+}
+
+/* ZINC
+ * Nothing else runs the queue on an idle or read-only device, so a fired epoch has to kick
+ * the hardware queues itself when management requests are queued. The run is asynchronous
+ * since we are in (hard)irq context here.
+ *
+ * epoch_armed is set by whoever (re)arms the timer, so that the timer is never started while
+ * its callback moves it forward. The callback clears it once no management request is queued
+ * and takes it back if a request was queued in the meantime, see zinc_epoch_arm().
+ */
+static enum hrtimer_restart zinc_epoch_timer_fn(struct hrtimer *t)
+{
+	struct deadline_data *dd = container_of(t, struct deadline_data, epoch_timer);
+	ktime_t now = ktime_get();
+	bool kick = false;
+
+	if (zinc_epoch_forward(&dd->reset, now) && zinc_mgmt_queued(&dd->reset)) {
+		atomic_set(&dd->reset.timer_fired, 1);
+		kick = true;
+	}
+	if (zinc_epoch_forward(&dd->finish, now) && zinc_mgmt_queued(&dd->finish)) {
+		atomic_set(&dd->finish.timer_fired, 1);
+		kick = true;
+	}
+	if (kick)
+		blk_mq_run_hw_queues(dd->queue, true);
+
+	/*
+	 * Both xchg are full barriers: either the queue sees epoch_armed cleared, or this
+	 * callback sees the queued request, see zinc_epoch_arm().
+	 */
+	if (!zinc_mgmt_any_queued(dd)) {
+		atomic_xchg(&dd->epoch_armed, 0);
+		if (!zinc_mgmt_any_queued(dd) || atomic_xchg(&dd->epoch_armed, 1))
+			return HRTIMER_NORESTART;
+	}
+
+	hrtimer_set_expires(t, zinc_epoch_next(dd));
+	return HRTIMER_RESTART;
+}
+
+/*
+ * ZINC: called with dd->lock held after a management request has been queued. The xchg orders
+ * the update of nr_queued before the check of epoch_armed.
+ */
+static void zinc_epoch_arm(struct deadline_data *dd)
+{
+	ktime_t now;
+
+	if (atomic_xchg(&dd->epoch_armed, 1))
+		return;
+
+	now = ktime_get();
+	zinc_epoch_forward(&dd->reset, now);
+	zinc_epoch_forward(&dd->finish, now);
+	hrtimer_start(&dd->epoch_timer, zinc_epoch_next(dd), HRTIMER_MODE_ABS);
+}
+
+/* ZINC: called with dd->lock held after the last queued management request left its queue */
+static void zinc_epoch_disarm(struct deadline_data *dd)
+{
+	/* A running callback disarms the timer itself */
+	if (hrtimer_try_to_cancel(&dd->epoch_timer) == 1)
+		atomic_set(&dd->epoch_armed, 0);
+}
+
+/* ZINC: writes queued in any priority, the lists may be checked without dd->lock */
+static bool zinc_writes_queued(struct deadline_data *dd)
+{
+	enum dd_prio p;
+
+	for (p = 0; p <= DD_PRIO_MAX; p++)
+		if (!list_empty_careful(&dd->per_prio[p].fifo_list[DD_WRITE]) ||
+		    !list_empty_careful(&dd->per_prio[p].fifo_list[DD_APPEND]))
+			return true;
+
+	return false;
+}
+
+/* ZINC: no write is queued or in flight */
+static inline bool zinc_write_idle(struct deadline_data *dd)
+{
+	return !zinc_pending_writes(dd) && !zinc_writes_queued(dd);
+}
+
+static enum hrtimer_restart zinc_idle_timer_fn(struct hrtimer *t)
+{
+	struct deadline_data *dd = container_of(t, struct deadline_data, idle_timer);
+
+	if (!zinc_write_idle(dd))
+		return HRTIMER_NORESTART;
+
+	atomic_set(&dd->reset.idle_fired, 1);
+	atomic_set(&dd->finish.idle_fired, 1);
+	if (zinc_mgmt_queued(&dd->reset) || zinc_mgmt_queued(&dd->finish))
+		blk_mq_run_hw_queues(dd->queue, true);
+	return HRTIMER_NORESTART;
+}
+
+/* ZINC: a plug window ended, see zinc_write_plugged() */
+static enum hrtimer_restart zinc_plug_timer_fn(struct hrtimer *t)
+{
+	struct deadline_data *dd = container_of(t, struct deadline_data, plug_timer);
+
+	blk_mq_run_hw_queues(dd->queue, true);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * ZINC
+ * Called when a write or management request completed. If that left the device without writes
+ * while management requests are queued, an idle window opens once no write arrived for
+ * idle_grace_us. Every later completion restarts the grace period, so a long idle period opens
+ * a window after every batch.
+ */
+static void zinc_idle_arm(struct deadline_data *dd)
+{
+	int grace_us = READ_ONCE(dd->idle_grace_us);
+
+	if (!grace_us || !zinc_write_idle(dd))
+		return;
+	if (!zinc_mgmt_queued(&dd->reset) && !zinc_mgmt_queued(&dd->finish))
+		return;
+
+	hrtimer_start(&dd->idle_timer, us_to_ktime(grace_us), HRTIMER_MODE_REL);
+}
+
+static void zinc_mgmt_init(struct deadline_data *dd, struct zinc_mgmt *zm,
+			   const char *name, int command_tokens, int maximum_epoch_holds,
+			   int epoch_interval_ms, int minimum_concurrency_treshold,
+			   int batch_size)
+{
+	enum dd_prio prio;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+
+		INIT_LIST_HEAD(&zmp->queue);
+		xa_init(&zmp->zones);
+		zmp->reset_all = NULL;
+		INIT_LIST_HEAD(&zmp->urgent);
+		zmp->nr_urgent = 0;
+		zmp->epoch = 0;
+		atomic_set(&zmp->dispatched_write, 0);
+		atomic_set(&zmp->dispatched_read, 0);
+	}
+	zm->nr_queued = 0;
+	zm->batch_left = 0;
+	memset(zm->cases, 0, sizeof(zm->cases));
+	zm->coalesced = 0;
+	atomic_set(&zm->idle_fired, 0);
+	zm->idle_left = 0;
+	zm->idle_issued = 0;
+	atomic_set(&zm->pending_requests, 0);
+	atomic_set(&zm->pending_reads, 0);
+	atomic_set(&zm->inflight, 0);
+	zm->bucket = 0;
+	zm->bucket_time = 0;
+	atomic_set(&zm->timer_fired, 0);
+
+	zm->command_tokens = command_tokens;
+	zm->maximum_epoch_holds = maximum_epoch_holds;
+	zm->epoch_interval_us = max(epoch_interval_ms * (int)USEC_PER_MSEC,
+				    ZINC_MIN_EPOCH_INTERVAL);
+	zm->minimum_concurrency_treshold = minimum_concurrency_treshold;
+	zm->batch_size = batch_size;
+	zm->min_cost = ZINC_COST_UNIT;
+	zm->urgent = 0;
+	zm->urgent_queue_depth = 0;
+	zm->urgent_epoch_holds = 0;
+	zm->max_inflight = 0;
+	zm->rate = 0;
+	zm->rate_burst = 1;
+	zm->rate_writes = 0;
+	zm->read_command_tokens = 0;
+	zm->minimum_read_concurrency_treshold = 0;
+	zm->adapt_scale = ZINC_ADAPT_SCALE_UNIT;
+	zm->dd = dd;
+	zm->name = name;
+	zm->next_epoch = ktime_add(ktime_get(), zinc_mgmt_epoch_interval(zm));
+}
+
+static void zinc_mgmt_exit(struct zinc_mgmt *zm)
+{
+	enum dd_prio prio;
+
+	WARN_ON_ONCE(zm->nr_queued);
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		xa_destroy(&zm->per_prio[prio].zones);
+}
+
+static inline unsigned int zinc_rq_zone_no(struct request *rq)
+{
+	return disk_zone_no(rq->q->disk, blk_rq_pos(rq));
+}
+
+/*
+ * ZINC
+ * Zones are assigned round-robin to zone_groups groups, matching drives that stripe consecutive
+ * zones over their parallel units.
+ */
+static inline unsigned int zinc_zone_group(struct deadline_data *dd,
+					   unsigned int zone_no)
+{
+	return zone_no % READ_ONCE(dd->zone_groups);
+}
+
+/* Only single zone operations are indexed, all other operations live on the queue only. */
+static inline bool zinc_mgmt_indexed(struct request *rq)
+{
+	return req_op(rq) == REQ_OP_ZONE_RESET || req_op(rq) == REQ_OP_ZONE_FINISH;
+}
+
+/*
+ * ZINC
+ * The block layer of this kernel does not keep the write pointers of zones, and reporting the
+ * zones from the scheduler would wait for the queue itself. Instead, ZINC estimates the write
+ * pointer of each zone from the requests it dispatches: writes move it forward, resets rewind
+ * it and finishes move it to the end of the zone. Zones that have not been written, reset or
+ * finished since the scheduler was attached are unknown.
+ */
+static void zinc_track_write_pointer(struct deadline_data *dd,
+				     struct request *rq)
+{
+	const sector_t zone_sectors = dd->queue->limits.chunk_sectors;
+	unsigned int zone_no;
+	u32 wp;
+
+	if (!dd->zone_wp)
+		return;
+
+	switch (req_op(rq)) {
+	case REQ_OP_ZONE_RESET_ALL:
+		memset32(dd->zone_wp, 0, dd->nr_zones);
+		return;
+	case REQ_OP_WRITE:
+	case REQ_OP_ZONE_APPEND:
+	case REQ_OP_ZONE_RESET:
+	case REQ_OP_ZONE_FINISH:
+		break;
+	default:
+		return;
+	}
+
+	zone_no = zinc_rq_zone_no(rq);
+	if (zone_no >= dd->nr_zones)
+		return;
+
+	wp = dd->zone_wp[zone_no];
+	switch (req_op(rq)) {
+	case REQ_OP_WRITE:
+		/* a write to a sequential zone starts at the write pointer */
+		wp = (blk_rq_pos(rq) & (zone_sectors - 1)) + blk_rq_sectors(rq);
+		break;
+	case REQ_OP_ZONE_APPEND:
+		if (wp != ZINC_WP_UNKNOWN)
+			wp += blk_rq_sectors(rq);
+		break;
+	case REQ_OP_ZONE_RESET:
+		wp = 0;
+		break;
+	default:
+		wp = zone_sectors;
+		break;
+	}
+	if (wp != ZINC_WP_UNKNOWN)
+		wp = min_t(sector_t, wp, zone_sectors);
+	WRITE_ONCE(dd->zone_wp[zone_no], wp);
+}
+
+/* ZINC: how full the zone of @rq is in ZINC_COST_UNIT, or -1 if it is unknown */
+static int zinc_zone_fill(struct deadline_data *dd, struct request *rq)
+{
+	unsigned int zone_no;
+	u32 wp;
+
+	if (!dd->zone_wp || !zinc_mgmt_indexed(rq))
+		return -1;
+	zone_no = zinc_rq_zone_no(rq);
+	if (zone_no >= dd->nr_zones)
+		return -1;
+	wp = READ_ONCE(dd->zone_wp[zone_no]);
+	if (wp == ZINC_WP_UNKNOWN)
+		return -1;
+
+	return div_u64((u64)wp * ZINC_COST_UNIT, dd->queue->limits.chunk_sectors);
+}
+
+/*
+ * ZINC
+ * Cost of the management request @rq in ZINC_COST_UNIT, which scales the command tokens it
+ * needs and consumes, see zinc_policy_cost(). Resets of all zones cost the full unit.
+ */
+static unsigned int zinc_mgmt_cost(struct deadline_data *dd,
+				   struct zinc_mgmt *zm, struct request *rq)
+{
+	int min_cost = READ_ONCE(zm->min_cost);
+
+	if (min_cost >= ZINC_COST_UNIT)
+		return ZINC_COST_UNIT;
+
+	return zinc_policy_cost(min_cost, zinc_zone_fill(dd, rq),
+				zm == &dd->finish);
+}
+
+static inline struct request *zinc_mgmt_zone_next(struct request *rq)
+{
+	return zinc_rq(rq)->next;
+}
+
+/* Number of epochs @rq has been held back. */
+static inline unsigned int zinc_mgmt_holds(struct zinc_mgmt_prio *zmp,
+					   struct request *rq)
+{
+	return zinc_policy_holds(zmp->epoch, zinc_rq(rq)->epoch);
+}
+
+static inline enum dd_prio zinc_rq_prio(struct request *rq)
+{
+	return ioprio_class_to_prio[IOPRIO_PRIO_CLASS(req_get_ioprio(rq))];
+}
+
+/*
+ * Queue @rq and add it to the zone index of its priority. If the index can not grow, the
+ * request is only queued, which merely hides it from zone lookups.
+ */
+static void zinc_mgmt_add(struct zinc_mgmt *zm, struct request *rq)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[zinc_rq_prio(rq)];
+	unsigned long zone_no = zinc_rq_zone_no(rq);
+	struct request *pos;
+
+	zinc_rq(rq)->epoch = zmp->epoch;
+	zinc_rq(rq)->next = NULL;
+	list_add_tail(&rq->queuelist, &zmp->queue);
+	WRITE_ONCE(zm->nr_queued, zm->nr_queued + 1);
+	if (zm->nr_queued == 1)
+		zinc_epoch_arm(zm->dd);
+	if (rq->cmd_flags & REQ_PRIO) {
+		zinc_rq(rq)->rq = rq;
+		list_add_tail(&zinc_rq(rq)->urgent, &zmp->urgent);
+		zmp->nr_urgent++;
+	}
+
+	if (req_op(rq) == REQ_OP_ZONE_RESET_ALL && !zmp->reset_all)
+		zmp->reset_all = rq;
+	if (!zinc_mgmt_indexed(rq))
+		return;
+
+	pos = xa_load(&zmp->zones, zone_no);
+	if (!pos) {
+		xa_store(&zmp->zones, zone_no, rq, GFP_ATOMIC);
+		return;
+	}
+	while (zinc_mgmt_zone_next(pos))
+		pos = zinc_mgmt_zone_next(pos);
+	zinc_rq(pos)->next = rq;
+}
+
+static void zinc_mgmt_del(struct zinc_mgmt *zm, struct request *rq)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[zinc_rq_prio(rq)];
+	unsigned long zone_no = zinc_rq_zone_no(rq);
+	struct request *pos;
+
+	list_del_init(&rq->queuelist);
+	WRITE_ONCE(zm->nr_queued, zm->nr_queued - 1);
+	if (!zm->nr_queued && !zinc_mgmt_any_queued(zm->dd))
+		zinc_epoch_disarm(zm->dd);
+	if (rq->cmd_flags & REQ_PRIO) {
+		list_del_init(&zinc_rq(rq)->urgent);
+		zmp->nr_urgent--;
+	}
+
+	if (zmp->reset_all == rq) {
+		zmp->reset_all = NULL;
+		list_for_each_entry(pos, &zmp->queue, queuelist) {
+			if (req_op(pos) == REQ_OP_ZONE_RESET_ALL) {
+				zmp->reset_all = pos;
+				break;
+			}
+		}
+	}
+	if (!zinc_mgmt_indexed(rq))
+		return;
+
+	pos = xa_load(&zmp->zones, zone_no);
+	if (pos == rq) {
+		if (zinc_mgmt_zone_next(rq))
+			xa_store(&zmp->zones, zone_no, zinc_mgmt_zone_next(rq),
+				 GFP_ATOMIC);
+		else
+			xa_erase(&zmp->zones, zone_no);
+	} else {
+		while (pos && zinc_mgmt_zone_next(pos) != rq)
+			pos = zinc_mgmt_zone_next(pos);
+		if (pos)
+			zinc_rq(pos)->next = zinc_mgmt_zone_next(rq);
+	}
+	zinc_rq(rq)->next = NULL;
+}
+
+/* ZINC: consume the command tokens of one issued management request, see zinc_policy_consume() */
+static void zinc_consume_tokens(atomic_t *dispatched, int command_tokens,
+				int batch_size)
+{
+	atomic_set(dispatched, zinc_policy_consume(atomic_read(dispatched),
+						   command_tokens, batch_size));
+}
+
+static void zinc_mgmt_consume_tokens(struct zinc_mgmt *zm, enum dd_prio prio,
+				     unsigned int cost)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+
+	zinc_consume_tokens(zinc_mgmt_write_tokens(zm, prio),
+			    zinc_policy_cost_tokens(zinc_mgmt_command_tokens(zm),
+						    prio, cost),
+			    zm->batch_size);
+	zinc_consume_tokens(&zmp->dispatched_read,
+			    zinc_policy_cost_tokens(zm->read_command_tokens,
+						    prio, cost),
+			    zm->batch_size);
+}
+
+/* ZINC: reads are only tracked when they take part in the decision of one of the queues */
+static inline bool zinc_mgmt_reads_tracked(struct zinc_mgmt *zm)
+{
+	return READ_ONCE(zm->read_command_tokens) ||
+		READ_ONCE(zm->minimum_read_concurrency_treshold);
+}
+
+/*
+ * ZINC
+ * In-flight writes that interfere with @rq. With zone groups, a single zone operation only
+ * interferes with the writes to its own zone group, and with all writes of the other members
+ * of the share group, whose zones are not known here.
+ */
+static int zinc_mgmt_pending(struct deadline_data *dd, struct zinc_mgmt *zm,
+			     struct request *rq)
+{
+	int pending = zinc_pending_writes(dd);
+
+	if (dd->zone_groups > 1 && zinc_mgmt_indexed(rq))
+		return atomic_read(&dd->group_pending_requests[
+				zinc_zone_group(dd, zinc_rq_zone_no(rq))]) +
+			max(pending - atomic_read(&zm->pending_requests), 0);
+
+	return pending;
+}
+
+/*
+ * ZINC: case 0, (almost) nothing is in flight that @rq interferes with. A reset of all zones
+ * interferes with every write, it is only issued without holds when no write is in flight.
+ */
+static bool zinc_mgmt_below_threshold(struct deadline_data *dd,
+				      struct zinc_mgmt *zm, struct request *rq)
+{
+	return zinc_policy_idle(zinc_mgmt_pending(dd, zm, rq),
+				zm->minimum_concurrency_treshold,
+				atomic_read(&zm->pending_reads),
+				zm->minimum_read_concurrency_treshold,
+				req_op(rq) == REQ_OP_ZONE_RESET_ALL);
+}
+
+/*
+ * ZINC
+ * Find a queued request that passes case 0. Without zone groups all queued requests see the
+ * same in-flight writes, so only the oldest one is checked. With zone groups the first
+ * ZINC_MGMT_SCAN_DEPTH requests are checked, to skip requests whose group is busy.
+ */
+static struct request *zinc_mgmt_find_idle(struct deadline_data *dd,
+					   struct zinc_mgmt *zm,
+					   struct zinc_mgmt_prio *zmp)
+{
+	struct request *rq;
+	int scanned = 0;
+
+	list_for_each_entry(rq, &zmp->queue, queuelist) {
+		if (zinc_mgmt_below_threshold(dd, zm, rq))
+			return rq;
+		if (dd->zone_groups <= 1 || ++scanned >= ZINC_MGMT_SCAN_DEPTH)
+			break;
+	}
+
+	return NULL;
+}
+
+/* ZINC case 1: the command tokens of @prio cover the cost of @rq */
+static bool zinc_mgmt_tokens(struct deadline_data *dd, struct zinc_mgmt *zm,
+			     enum dd_prio prio, struct request *rq)
+{
+	return zinc_policy_tokens(atomic_read(zinc_mgmt_write_tokens(zm, prio)),
+				  zinc_mgmt_command_tokens(zm),
+				  atomic_read(&zm->per_prio[prio].dispatched_read),
+				  zm->read_command_tokens, prio,
+				  zinc_mgmt_cost(dd, zm, rq));
+}
+
+/*
+ * ZINC
+ * With write striping and zone groups, a request issued for its command tokens is taken from
+ * the zone group with the least in-flight writes among the first ZINC_MGMT_SCAN_DEPTH queued
+ * requests, so that it interferes with as few writes as possible. With @tokens, only requests
+ * whose cost the command tokens cover are taken, @head is known to be covered.
+ */
+static struct request *zinc_mgmt_least_busy(struct deadline_data *dd,
+					    struct zinc_mgmt *zm, enum dd_prio prio,
+					    struct request *head, bool tokens)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+	struct request *rq, *best = head;
+	int best_pending = zinc_mgmt_pending(dd, zm, head);
+	int scanned = 0;
+
+	if (!READ_ONCE(dd->write_striping) || dd->zone_groups <= 1)
+		return head;
+
+	list_for_each_entry(rq, &zmp->queue, queuelist) {
+		int pending;
+
+		if (++scanned > ZINC_MGMT_SCAN_DEPTH)
+			break;
+		if (!zinc_mgmt_indexed(rq))
+			continue;
+		pending = zinc_mgmt_pending(dd, zm, rq);
+		if (pending >= best_pending)
+			continue;
+		if (!tokens || zinc_mgmt_tokens(dd, zm, prio, rq)) {
+			best = rq;
+			best_pending = pending;
+		}
+	}
+
+	return best;
+}
+
+/* ZINC: ask the selected policy whether @rq, the oldest request of @prio, may be issued */
+static enum zinc_policy_verdict zinc_ops_should_dispatch(struct deadline_data *dd,
+							 struct zinc_mgmt *zm,
+							 enum dd_prio prio,
+							 struct request *rq)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+	enum zinc_policy_verdict verdict = ZINC_POLICY_DEFAULT;
+	struct zinc_policy_ops *ops;
+
+	rcu_read_lock();
+	ops = rcu_dereference(dd->policy);
+	if (ops && ops->should_dispatch) {
+		struct zinc_mgmt_state state = {
+			.queue = zm->name,
+			.prio = prio,
+			.holds = zinc_mgmt_holds(zmp, rq),
+			.cost = zinc_mgmt_cost(dd, zm, rq),
+			.nr_queued = zm->nr_queued,
+			.pending_writes = zinc_mgmt_pending(dd, zm, rq),
+			.pending_reads = atomic_read(&zm->pending_reads),
+			.dispatched_writes = atomic_read(zinc_mgmt_write_tokens(zm, prio)),
+			.dispatched_reads = atomic_read(&zmp->dispatched_read),
+			.command_tokens = zinc_mgmt_command_tokens(zm),
+			.maximum_epoch_holds = zm->maximum_epoch_holds,
+			.minimum_concurrency_treshold = zm->minimum_concurrency_treshold,
+		};
+
+		verdict = ops->should_dispatch(dd->queue, rq, &state);
+	}
+	rcu_read_unlock();
+
+	return verdict;
+}
+
+/*
+ * ZINC rate mode
+ * Every issued request draws tokens for its cost from a bucket refilled at rate operations per
+ * second, which holds rate_burst operations. Nothing is issued while the bucket holds less than
+ * one operation, so the management bandwidth is bounded whatever the write mix. The bucket
+ * replaces the command tokens of case 1, unless rate_writes asks for both.
+ */
+static bool zinc_mgmt_bucket_refill(struct zinc_mgmt *zm)
+{
+	u64 now;
+
+	if (!zm->rate)
+		return true;
+
+	now = ktime_get_ns();
+	zm->bucket = zinc_policy_bucket_refill(zm->bucket, now - zm->bucket_time,
+					       zm->rate, zm->rate_burst);
+	zm->bucket_time = now;
+
+	return zm->bucket >= ZINC_BUCKET_OP;
+}
+
+static void zinc_mgmt_bucket_consume(struct zinc_mgmt *zm, unsigned int cost)
+{
+	u64 tokens = zinc_policy_bucket_cost(cost);
+
+	if (zm->rate)
+		zm->bucket = zm->bucket > tokens ? zm->bucket - tokens : 0;
+}
+
+/*
+ * ZINC: pick the management request of priority @prio that may be issued now, if any. The
+ * reason to issue it is returned in @reason.
+ */
+static struct request *zinc_mgmt_pick(struct deadline_data *dd,
+				      struct zinc_mgmt *zm, enum dd_prio prio,
+				      enum zinc_mgmt_case *reason)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+	struct request *rq = list_first_entry(&zmp->queue, struct request, queuelist);
+	struct request *idle;
+
+	// The selected policy decides first, it may leave the decision to the cases below
+	switch (zinc_ops_should_dispatch(dd, zm, prio, rq)) {
+	case ZINC_POLICY_ISSUE:
+		*reason = ZINC_CASE_POLICY;
+		return rq;
+	case ZINC_POLICY_HOLD:
+		return NULL;
+	case ZINC_POLICY_DEFAULT:
+		break;
+	}
+
+	// case 0: The number of pending requests is less to the threshold, dispatch
+	//         (if reads are considered, the pending reads also need to be below the read threshold)
+	*reason = ZINC_CASE_IDLE;
+	idle = zinc_mgmt_find_idle(dd, zm, zmp);
+	if (idle)
+		return idle;
+
+	// case 1: We have dispatched enough write (or read) of this priority, then dispatch
+	//         (not for a reset of all zones, it waits for idle writes or the maximum holds)
+	//         (the tokens needed scale with the cost of the request issued)
+	//         (in the rate mode the bucket holds the tokens, see zinc_mgmt_bucket_refill())
+	*reason = ZINC_CASE_TOKENS;
+	if (req_op(rq) == REQ_OP_ZONE_RESET_ALL)
+		goto holds;
+	if (zm->rate && !zm->rate_writes)
+		return zinc_mgmt_least_busy(dd, zm, prio, rq, false);
+	if (zinc_mgmt_tokens(dd, zm, prio, rq))
+		return zinc_mgmt_least_busy(dd, zm, prio, rq, true);
+
+	// case 2: We haven't dispatched enough write, but the request has been held for too long
+holds:
+	*reason = ZINC_CASE_HOLDS;
+	if (zinc_policy_held(zinc_mgmt_holds(zmp, rq), zm->maximum_epoch_holds))
+		return rq;
+
+	return NULL;
+}
+
+static void zinc_trace_issue(struct deadline_data *dd, struct zinc_mgmt *zm,
+			     enum dd_prio prio, struct request *rq,
+			     enum zinc_mgmt_case reason)
+{
+	struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+	unsigned int holds = zinc_mgmt_holds(zmp, rq);
+	int pending_writes = zinc_mgmt_pending(dd, zm, rq);
+	int pending_reads = atomic_read(&zm->pending_reads);
+	int dispatched_writes = atomic_read(zinc_mgmt_write_tokens(zm, prio));
+	int dispatched_reads = atomic_read(&zmp->dispatched_read);
+
+	switch (reason) {
+	case ZINC_CASE_IDLE:
+		trace_zinc_mgmt_idle(rq, zm->name, prio, holds, pending_writes,
+				     pending_reads, dispatched_writes,
+				     dispatched_reads);
+		break;
+	case ZINC_CASE_TOKENS:
+		trace_zinc_mgmt_tokens(rq, zm->name, prio, holds, pending_writes,
+				       pending_reads, dispatched_writes,
+				       dispatched_reads);
+		break;
+	case ZINC_CASE_HOLDS:
+		trace_zinc_mgmt_holds(rq, zm->name, prio, holds, pending_writes,
+				      pending_reads, dispatched_writes,
+				      dispatched_reads);
+		break;
+	case ZINC_CASE_URGENT:
+		trace_zinc_mgmt_urgent(rq, zm->name, prio, holds, pending_writes,
+				       pending_reads, dispatched_writes,
+				       dispatched_reads);
+		break;
+	case ZINC_CASE_POLICY:
+		trace_zinc_mgmt_policy(rq, zm->name, prio, holds, pending_writes,
+				       pending_reads, dispatched_writes,
+				       dispatched_reads);
+		break;
+	}
+}
+
+/*
+ * ZINC
+ * In an idle window, up to batch_size management requests of a queue are issued right away,
+ * oldest and highest priority first, without waiting for the epoch or for command tokens. The
+ * window closes as soon as a write is queued or dispatched. The read threshold still holds.
+ */
+static struct request *zinc_mgmt_idle_pick(struct deadline_data *dd,
+					   struct zinc_mgmt *zm,
+					   enum dd_prio *prio)
+{
+	if (atomic_cmpxchg(&zm->idle_fired, 1, 0))
+		zm->idle_left = zm->batch_size;
+
+	if (!zm->idle_left || !zm->nr_queued)
+		return NULL;
+	if (!zinc_write_idle(dd)) {
+		zm->idle_left = 0;
+		return NULL;
+	}
+	if (zm->minimum_read_concurrency_treshold &&
+	    atomic_read(&zm->pending_reads) >= zm->minimum_read_concurrency_treshold)
+		return NULL;
+
+	for (*prio = 0; *prio <= DD_PRIO_MAX; (*prio)++)
+		if (!list_empty(&zm->per_prio[*prio].queue))
+			return list_first_entry(&zm->per_prio[*prio].queue,
+						struct request, queuelist);
+
+	return NULL;
+}
+
+/*
+ * ZINC
+ * Urgent requests, for instance resets while the file system runs out of empty zones, are
+ * issued once held back for urgent_epoch_holds epochs (at once by default), on any dispatch and
+ * not only in fired epochs. A request is urgent if it was submitted with REQ_PRIO, if the
+ * urgent hint is set or if urgent_queue_depth requests are queued. Other requests remain
+ * throttled. Requests with REQ_PRIO are also kept on an urgent list per priority, so the oldest
+ * urgent request is found without walking the queue.
+ */
+static struct request *zinc_mgmt_urgent_pick(struct zinc_mgmt *zm,
+					     enum dd_prio *prio)
+{
+	const int urgent_epoch_holds = READ_ONCE(zm->urgent_epoch_holds);
+	bool all = READ_ONCE(zm->urgent) ||
+		zinc_policy_pressure(zm->nr_queued, READ_ONCE(zm->urgent_queue_depth));
+	struct request *rq;
+
+	for (*prio = 0; *prio <= DD_PRIO_MAX; (*prio)++) {
+		struct zinc_mgmt_prio *zmp = &zm->per_prio[*prio];
+
+		/*
+		 * Both lists are in arrival order, so their first request is held back the
+		 * longest. If it can not be issued, no later one of the priority can.
+		 */
+		if (all && !list_empty(&zmp->queue))
+			rq = list_first_entry(&zmp->queue, struct request, queuelist);
+		else if (zmp->nr_urgent)
+			rq = list_first_entry(&zmp->urgent, struct zinc_rq, urgent)->rq;
+		else
+			continue;
+		if (zinc_policy_urgent(zinc_mgmt_holds(zmp, rq), urgent_epoch_holds))
+			return rq;
+	}
+
+	return NULL;
+}
+
+/*
+ * ZINC
+ * If the timer is fired, a new batch of up to batch_size management requests starts. For each
+ * request of the batch, check if the oldest queued management request of a priority can be
+ * issued, from RT to IDLE. If no priority can issue one, the batch ends and, when nothing was
+ * issued in this epoch yet, the epoch of every priority that is held back is postponed, which
+ * ages all its queued requests at once.
+ */
+static struct request *zinc_mgmt_dispatch(struct deadline_data *dd,
+					  struct zinc_mgmt *zm)
+{
+	struct request *rq;
+	bool new_epoch = false;
+	enum zinc_mgmt_case reason;
+	enum dd_prio prio;
+	unsigned int cost;
+
+	lockdep_assert_held(&dd->lock);
+
+	/*
+	 * Nothing is issued while max_inflight requests are in flight, whatever the case. A
+	 * fired epoch is kept for the completion that frees a slot and reruns the queue.
+	 */
+	if (zm->max_inflight && atomic_read(&zm->inflight) >= zm->max_inflight)
+		return NULL;
+	if (!zinc_mgmt_bucket_refill(zm))
+		return NULL;
+
+	rq = zinc_mgmt_idle_pick(dd, zm, &prio);
+	if (rq) {
+		zm->idle_left--;
+		zm->idle_issued++;
+		reason = ZINC_CASE_IDLE;
+		goto issue;
+	}
+
+	rq = zinc_mgmt_urgent_pick(zm, &prio);
+	if (rq) {
+		reason = ZINC_CASE_URGENT;
+		goto issue;
+	}
+
+	if (atomic_cmpxchg(&zm->timer_fired, 1, 0)) {
+		zm->batch_left = zm->batch_size;
+		new_epoch = true;
+		zinc_ops_call(dd, epoch, zm->name, zm->nr_queued);
+	}
+
+	if (!zm->batch_left)
+		return NULL;
+
+	if (!zm->nr_queued) {
+		zm->batch_left = 0;
+		return NULL;
+	}
 
-	int finish_command_tokens;
-	int finish_maximum_epoch_holds;
-	int finish_epoch_interval;     	// in jiffies
-	int finish_minimum_concurrency_treshold; // threshold of the maximum number of pending requests in 8KiB units
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		if (list_empty(&zm->per_prio[prio].queue))
+			continue;
+		rq = zinc_mgmt_pick(dd, zm, prio, &reason);
+		if (rq)
+			goto dispatch;
+	}
+
+	// case 3: We can not dispatch, then we postpone the epoch for all queued requests.
+	//         Then continue to dispatch a normal request.
+	trace_zinc_mgmt_postpone(dd->queue, zm->name, zm->nr_queued,
+				 atomic_read(&zm->pending_requests),
+				 atomic_read(&zm->pending_reads), new_epoch);
+	zm->cases[ZINC_CASE_POSTPONE]++;
+	zm->batch_left = 0;
+	if (new_epoch)
+		for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+			if (!list_empty(&zm->per_prio[prio].queue))
+				zm->per_prio[prio].epoch++;
+	return NULL;
+
+dispatch:
+	zm->batch_left--;
+issue:
+	if (trace_zinc_mgmt_idle_enabled() || trace_zinc_mgmt_tokens_enabled() ||
+	    trace_zinc_mgmt_holds_enabled() || trace_zinc_mgmt_urgent_enabled() ||
+	    trace_zinc_mgmt_policy_enabled())
+		zinc_trace_issue(dd, zm, prio, rq, reason);
+	zm->cases[reason]++;
+	zinc_mgmt_del(zm, rq);
+	zinc_rq(rq)->mgmt_inflight = true;
+	atomic_inc(&zm->inflight);
+	cost = zinc_mgmt_cost(dd, zm, rq);
+	zinc_mgmt_consume_tokens(zm, prio, cost);
+	zinc_mgmt_bucket_consume(zm, cost);
+	return rq;
+}
+
+/*
+ * ZINC
+ * Requests coalesced into a reset are chained through zinc_rq->next (no longer used once a
+ * request left its queue) on rq->end_io_data of the reset. They complete with the status of
+ * the reset, only once the reset itself completed, so that no one writes to the zone before
+ * it is actually reset.
+ */
+static enum rq_end_io_ret zinc_mgmt_end_io(struct request *rq,
+					   blk_status_t error)
+{
+	struct request *next = rq->end_io_data;
+
+	rq->end_io = NULL;
+	rq->end_io_data = NULL;
+	while (next) {
+		struct request *coalesced = next;
+
+		next = zinc_rq(coalesced)->next;
+		zinc_rq(coalesced)->next = NULL;
+		blk_mq_end_request(coalesced, error);
+	}
+
+	return RQ_END_IO_FREE;
+}
+
+static void zinc_mgmt_attach(struct request *rq, struct request *coalesced)
+{
+	zinc_rq(coalesced)->next = rq->end_io_data;
+	rq->end_io_data = coalesced;
+	rq->end_io = zinc_mgmt_end_io;
+}
+
+/*
+ * ZINC
+ * A new reset of all zones takes over all queued single zone resets and finishes of its
+ * priority class, they are completed together with it.
+ */
+static void zinc_mgmt_coalesce_all(struct deadline_data *dd, struct request *rq,
+				   enum dd_prio prio)
+{
+	struct request *pos, *next;
+
+	list_for_each_entry_safe(pos, next, &dd->reset.per_prio[prio].queue,
+				 queuelist) {
+		if (req_op(pos) != REQ_OP_ZONE_RESET)
+			continue;
+		zinc_mgmt_del(&dd->reset, pos);
+		zinc_mgmt_attach(rq, pos);
+		dd->reset.coalesced++;
+	}
+	list_for_each_entry_safe(pos, next, &dd->finish.per_prio[prio].queue,
+				 queuelist) {
+		if (req_op(pos) != REQ_OP_ZONE_FINISH)
+			continue;
+		zinc_mgmt_del(&dd->finish, pos);
+		zinc_mgmt_attach(rq, pos);
+		dd->finish.coalesced++;
+	}
+}
+
+/*
+ * ZINC
+ * With mgmt_coalesce, a reset of a zone that is already queued in the same priority class,
+ * either by a reset of that zone or by a reset of all zones, is completed together with the
+ * queued reset. Queued finishes of the zone, which are wasted work, are completed together
+ * with the new reset. Returns true if @rq is not queued itself. Requests that complete
+ * through their own end_io (passthrough) are never coalesced.
+ */
+static bool zinc_mgmt_coalesce(struct deadline_data *dd, struct request *rq)
+{
+	const enum dd_prio prio = zinc_rq_prio(rq);
+	struct zinc_mgmt_prio *zmp = &dd->reset.per_prio[prio];
+	unsigned long zone_no;
+	struct request *pos;
+
+	if (rq->end_io && rq->end_io != zinc_mgmt_end_io)
+		return false;
+	if (req_op(rq) == REQ_OP_ZONE_RESET_ALL) {
+		zinc_mgmt_coalesce_all(dd, rq, prio);
+		return false;
+	}
+	if (req_op(rq) != REQ_OP_ZONE_RESET)
+		return false;
+
+	zone_no = zinc_rq_zone_no(rq);
+	pos = zmp->reset_all ?: xa_load(&zmp->zones, zone_no);
+	if (pos && !rq->end_io &&
+	    (!pos->end_io || pos->end_io == zinc_mgmt_end_io)) {
+		zinc_mgmt_attach(pos, rq);
+		dd->reset.coalesced++;
+		return true;
+	}
+
+	while ((pos = xa_load(&dd->finish.per_prio[prio].zones, zone_no))) {
+		zinc_mgmt_del(&dd->finish, pos);
+		zinc_mgmt_attach(rq, pos);
+		dd->finish.coalesced++;
+	}
+
+	return false;
+}
+
+/* ZINC
+ * Queue a management request, the timer is forced if there is (almost) no write in flight.
+ */
+static void zinc_mgmt_insert(struct deadline_data *dd, struct zinc_mgmt *zm,
+			     struct request *rq)
+{
+	lockdep_assert_held(&dd->lock);
+
+	zinc_rq(rq)->state = ZINC_RQ_MGMT;
+	trace_block_rq_insert(rq);
+	if (READ_ONCE(dd->mgmt_coalesce) && zinc_mgmt_coalesce(dd, rq))
+		return;
+
+	zinc_mgmt_add(zm, rq);
+	zinc_ops_call(dd, mgmt_insert, rq);
+	if (zinc_mgmt_below_threshold(dd, zm, rq))
+		atomic_set(&zm->timer_fired, 1);
+}
+
+static void zinc_adapt_set_scale(struct deadline_data *dd, int scale)
+{
+	WRITE_ONCE(dd->reset.adapt_scale, scale);
+	WRITE_ONCE(dd->finish.adapt_scale, scale);
+}
+
+/*
+ * ZINC adaptive controller, similar to the Kyber domain depth adjustment.
+ * If the write p99 of the last window is above the target, management requests interfere too
+ * much and need more command tokens and longer epochs. If the p99 has headroom left, both are
+ * shrunk again so that management requests are issued earlier.
+ */
+static void zinc_adapt_update(struct deadline_data *dd)
+{
+	struct zinc_adapt *za = &dd->adapt;
+	unsigned int buckets[ZINC_LAT_BUCKETS];
+	unsigned int samples = 0, percentile_samples;
+	int bucket, scale;
+
+	for (bucket = 0; bucket < ZINC_LAT_BUCKETS; bucket++) {
+		buckets[bucket] = atomic_xchg(&za->latency_buckets[bucket], 0);
+		samples += buckets[bucket];
+	}
+
+	if (samples < ZINC_ADAPT_MIN_SAMPLES)
+		return;
+
+	percentile_samples = DIV_ROUND_UP(samples * 99, 100);
+	for (bucket = 0; bucket < ZINC_LAT_BUCKETS - 1; bucket++) {
+		if (buckets[bucket] >= percentile_samples)
+			break;
+		percentile_samples -= buckets[bucket];
+	}
 
-	// ZINC timers
-	atomic_t reset_timer_fired;
-	struct timer_list reset_timer;
+	scale = READ_ONCE(dd->reset.adapt_scale);
+	if (bucket >= ZINC_LAT_GOOD_BUCKETS)
+		scale += scale / 4;
+	else if (bucket < ZINC_LAT_GOOD_BUCKETS - 1)
+		scale -= scale / 8;
+	else
+		return;
 
-	atomic_t finish_timer_fired;
-	struct timer_list finish_timer;
+	zinc_adapt_set_scale(dd, clamp_t(int, scale, ZINC_ADAPT_SCALE_MIN,
+					 ZINC_ADAPT_SCALE_MAX));
+}
 
-	/*
-	 * MQ run time data
-	 */
+/* Called on write completion, @latency_ns is the device service time of the write. */
+static void zinc_adapt_sample(struct deadline_data *dd, u64 latency_ns)
+{
+	struct zinc_adapt *za = &dd->adapt;
+	u64 target_ns = (u64)READ_ONCE(dd->target_write_latency_us) * NSEC_PER_USEC;
+	unsigned long window_end;
+	u64 bucket;
 
-	struct dd_per_prio per_prio[DD_PRIO_COUNT];
+	if (!target_ns)
+		return;
 
-	/* MQ Data direction of latest dispatched request. */
-	enum dd_data_dir last_dir;
-	unsigned int batching;		/* number of sequential requests made */
-	unsigned int starved;		/* times reads have starved writes */
+	bucket = div64_u64(latency_ns * ZINC_LAT_GOOD_BUCKETS, target_ns);
+	atomic_inc(&za->latency_buckets[min_t(u64, bucket, ZINC_LAT_BUCKETS - 1)]);
 
-	/*
-	 * MQ settings that change how the i/o scheduler behaves
-	 */
-	int fifo_expire[DD_DIR_COUNT];
-	int fifo_batch;
-	int writes_starved;
-	int front_merges;
-	u32 async_depth;
-	int prio_aging_expire;
+	window_end = READ_ONCE(za->window_end);
+	if (time_before(jiffies, window_end))
+		return;
+	if (cmpxchg(&za->window_end, window_end,
+		    jiffies + msecs_to_jiffies(ZINC_ADAPT_WINDOW)) != window_end)
+		return;
 
-	spinlock_t lock;
-	spinlock_t zone_lock;
-};
+	zinc_adapt_update(dd);
+}
 
-/* Maps an I/O priority class to a deadline scheduler priority. */
-static const enum dd_prio ioprio_class_to_prio[] = {
-	[IOPRIO_CLASS_NONE]	= DD_BE_PRIO,
-	[IOPRIO_CLASS_RT]	= DD_RT_PRIO,
-	[IOPRIO_CLASS_BE]	= DD_BE_PRIO,
-	[IOPRIO_CLASS_IDLE]	= DD_IDLE_PRIO,
-};
+static inline enum zinc_hist_op zinc_hist_op(enum dd_data_dir data_dir)
+{
+	if (data_dir == ZINC_READ)
+		return ZINC_HIST_READ;
+	if (zinc_is_write_dir(data_dir))
+		return ZINC_HIST_WRITE;
+	if (data_dir == ZINC_FINISH)
+		return ZINC_HIST_FINISH;
+	if (zinc_is_reset_dir(data_dir))
+		return ZINC_HIST_RESET;
+	return ZINC_HIST_OPS;
+}
 
-/* ZINC timers
- * When the timer is fired, we set the timer-fired flag to true and start a new timer.
- * This is not protected by lock, even if there is a race condition, we only miss a reset dispatch, protected it by a timer
- * will serialized the timer with the insert/dispatch function. MIGHT CAUSE A DEADLOCK.
- */
-static void zinc_fin_reset_timer_fn(struct timer_list *t)
+static inline unsigned int zinc_hist_bucket(u64 latency_ns)
 {
-	struct deadline_data *zd = from_timer(zd, t, reset_timer);
-	atomic_set(&zd->reset_timer_fired, 1);
-	timer_reduce(&zd->reset_timer, jiffies + zd->reset_epoch_interval);
+	return min_t(unsigned int, fls64(div_u64(latency_ns, NSEC_PER_USEC)),
+		     ZINC_HIST_BUCKETS - 1);
 }
 
-static void zinc_fin_finish_timer_fn(struct timer_list *t)
+/* ZINC: called on completion of a request that was issued with a timestamp */
+static void zinc_hist_sample(struct deadline_data *dd, struct request *rq, u64 now)
 {
-	struct deadline_data *zd = from_timer(zd, t, finish_timer);
-	atomic_set(&zd->finish_timer_fired, 1);
-	timer_reduce(&zd->finish_timer, jiffies + zd->finish_epoch_interval);
+	struct zinc_hist *zh = &dd->hist;
+	const enum zinc_hist_op op = zinc_hist_op(zinc_data_dir(rq));
+
+	if (op == ZINC_HIST_OPS)
+		return;
+
+	if (rq->start_time_ns && rq->io_start_time_ns >= rq->start_time_ns)
+		atomic_inc(&zh->wait[op][zinc_hist_bucket(rq->io_start_time_ns -
+							  rq->start_time_ns)]);
+	if (now >= rq->io_start_time_ns)
+		atomic_inc(&zh->service[op][zinc_hist_bucket(now -
+							     rq->io_start_time_ns)]);
 }
 
 
@@ -258,22 +1744,67 @@ deadline_latter_request(struct request *rq)
 	return NULL;
 }
 
+/*
+ * ZINC
+ * The bit of a zone in write_zones is set while writes to that zone are on the write sort
+ * list. It is cleared when the last one of them leaves, which is the case when neither of its
+ * neighbours in sector order targets the same zone. Bits may be left set by merges, they are
+ * cleared on lookup.
+ */
+static inline bool zinc_tracks_write_zone(struct deadline_data *dd,
+					  struct dd_per_prio *per_prio,
+					  struct request *rq)
+{
+	return per_prio->write_zones && zinc_data_dir(rq) == DD_WRITE &&
+		zinc_rq_zone_no(rq) < dd->nr_write_zones;
+}
+
+static void zinc_add_write_zone(struct deadline_data *dd,
+				struct dd_per_prio *per_prio, struct request *rq)
+{
+	if (zinc_tracks_write_zone(dd, per_prio, rq))
+		__set_bit(zinc_rq_zone_no(rq), per_prio->write_zones);
+}
+
+static void zinc_del_write_zone(struct deadline_data *dd,
+				struct dd_per_prio *per_prio, struct request *rq)
+{
+	unsigned int zone_no;
+	struct request *next;
+
+	if (!zinc_tracks_write_zone(dd, per_prio, rq))
+		return;
+
+	zone_no = zinc_rq_zone_no(rq);
+	next = deadline_earlier_request(rq);
+	if (next && zinc_rq_zone_no(next) == zone_no)
+		return;
+	next = deadline_latter_request(rq);
+	if (next && zinc_rq_zone_no(next) == zone_no)
+		return;
+	__clear_bit(zone_no, per_prio->write_zones);
+}
+
 static void
-deadline_add_rq_rb(struct dd_per_prio *per_prio, struct request *rq)
+deadline_add_rq_rb(struct deadline_data *dd, struct dd_per_prio *per_prio,
+		   struct request *rq)
 {
 	struct rb_root *root = deadline_rb_root(per_prio, rq);
 
 	elv_rb_add(root, rq);
+	zinc_add_write_zone(dd, per_prio, rq);
 }
 
 static inline void
-deadline_del_rq_rb(struct dd_per_prio *per_prio, struct request *rq)
+deadline_del_rq_rb(struct deadline_data *dd, struct dd_per_prio *per_prio,
+		   struct request *rq)
 {
 	const enum dd_data_dir data_dir = zinc_data_dir(rq);
 
 	if (per_prio->next_rq[data_dir] == rq)
 		per_prio->next_rq[data_dir] = deadline_latter_request(rq);
 
+	zinc_del_write_zone(dd, per_prio, rq);
 	elv_rb_del(deadline_rb_root(per_prio, rq), rq);
 }
 
@@ -290,7 +1821,7 @@ static void deadline_remove_request(struct request_queue *q,
 	 * We might not be on the rbtree, if we are doing an insert merge
 	 */
 	if (!RB_EMPTY_NODE(&rq->rb_node))
-		deadline_del_rq_rb(per_prio, rq);
+		deadline_del_rq_rb(q->elevator->elevator_data, per_prio, rq);
 
 	elv_rqhash_del(q, rq);
 	if (q->last_merge == rq)
@@ -310,7 +1841,7 @@ static void dd_request_merged(struct request_queue *q, struct request *req,
 	 */
 	if (type == ELEVATOR_FRONT_MERGE) {
 		elv_rb_del(deadline_rb_root(per_prio, req), req);
-		deadline_add_rq_rb(per_prio, req);
+		deadline_add_rq_rb(dd, per_prio, req);
 	}
 }
 
@@ -424,6 +1955,205 @@ static struct request *deadline_skip_seq_writes(struct deadline_data *dd,
 	return rq;
 }
 
+#ifdef CONFIG_BLK_DEV_ZONED
+/* ZINC: the queued write with the lowest sector in zone @zone_no, if any */
+static struct request *zinc_first_zone_write(struct dd_per_prio *per_prio,
+					     struct request_queue *q,
+					     unsigned int zone_no)
+{
+	sector_t start = (sector_t)zone_no << ilog2(q->limits.chunk_sectors);
+	struct rb_node *node = per_prio->sort_list[DD_WRITE].rb_node;
+	struct request *rq = NULL;
+
+	while (node) {
+		struct request *pos = rb_entry_rq(node);
+
+		if (blk_rq_pos(pos) >= start) {
+			rq = pos;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	if (rq && zinc_rq_zone_no(rq) != zone_no)
+		return NULL;
+	return rq;
+}
+
+/*
+ * ZINC write plugging
+ * A zone is plugged for write_plug_us after its first queued write was inserted, as long as
+ * that write is smaller than max_sectors, does not end at the end of the zone and is the only
+ * queued write of its contiguous run. Contiguous writes that arrive in the meantime are merged
+ * into it at insert, so that fewer and larger writes are dispatched. The first queued write
+ * decides for the whole zone, later writes of the zone must not pass it.
+ */
+static bool zinc_write_plugged(struct deadline_data *dd, struct request *rq)
+{
+	struct request_queue *q = dd->queue;
+	int plug_us = READ_ONCE(dd->write_plug_us);
+	struct request *first, *next;
+	sector_t end;
+	u64 expiry;
+
+	if (!plug_us || zinc_data_dir(rq) != DD_WRITE)
+		return false;
+
+	first = zinc_first_zone_write(&dd->per_prio[zinc_rq_prio(rq)], q,
+				      zinc_rq_zone_no(rq));
+	if (!first || blk_rq_sectors(first) >= queue_max_sectors(q))
+		return false;
+	end = blk_rq_pos(first) + blk_rq_sectors(first);
+	if (!(end & (q->limits.chunk_sectors - 1)))
+		return false;
+	next = deadline_latter_request(first);
+	if (next && blk_rq_pos(next) == end)
+		return false;
+
+	expiry = zinc_rq(first)->plug_start + (u64)plug_us * NSEC_PER_USEC;
+	if (expiry <= ktime_get_ns())
+		return false;
+
+	if (!hrtimer_is_queued(&dd->plug_timer) ||
+	    ktime_before(ns_to_ktime(expiry), hrtimer_get_expires(&dd->plug_timer)))
+		hrtimer_start(&dd->plug_timer, ns_to_ktime(expiry), HRTIMER_MODE_ABS);
+	return true;
+}
+
+/*
+ * ZINC
+ * Find the first write of the first zone in [@from, @to) that has queued writes and is not
+ * write locked, with one bitmap scan instead of walking the queued writes. Called with the
+ * zone lock held.
+ */
+static struct request *zinc_next_write_range(struct deadline_data *dd,
+					     struct dd_per_prio *per_prio,
+					     unsigned int from, unsigned int to)
+{
+	struct request_queue *q = dd->queue;
+	unsigned long *locked = q->disk->seq_zones_wlock;
+	unsigned int zone_no;
+	struct request *rq;
+
+	for (zone_no = find_next_andnot_bit(per_prio->write_zones, locked, to, from);
+	     zone_no < to;
+	     zone_no = find_next_andnot_bit(per_prio->write_zones, locked, to,
+					    zone_no + 1)) {
+		rq = zinc_first_zone_write(per_prio, q, zone_no);
+		if (!rq) {
+			__clear_bit(zone_no, per_prio->write_zones);
+			continue;
+		}
+		if (!zinc_write_plugged(dd, rq))
+			return rq;
+	}
+
+	return NULL;
+}
+
+/*
+ * ZINC
+ * Next dispatchable write starting at zone @zone_no, wrapping around if @wrap. Returns
+ * ERR_PTR(-EOPNOTSUPP) if the zones are not tracked, the callers then walk the writes.
+ * Zones are only tracked for non-rotational devices, HDDs keep walking the writes to
+ * preserve sequential write streams.
+ */
+static struct request *zinc_next_write(struct deadline_data *dd,
+				       struct dd_per_prio *per_prio,
+				       unsigned int zone_no, bool wrap)
+{
+	struct request *rq;
+
+	if (!per_prio->write_zones || !dd->queue->disk->seq_zones_wlock ||
+	    zone_no >= dd->nr_write_zones)
+		return ERR_PTR(-EOPNOTSUPP);
+
+	rq = zinc_next_write_range(dd, per_prio, zone_no, dd->nr_write_zones);
+	if (!rq && wrap && zone_no)
+		rq = zinc_next_write_range(dd, per_prio, 0, zone_no);
+	return rq;
+}
+
+/*
+ * ZINC
+ * With write_striping, writes are dispatched round-robin over the zones with queued writes,
+ * starting after the zone of the last dispatched write, so that consecutive writes spread over
+ * the parallel units of the device instead of following the sector order. With zone groups,
+ * the first ZINC_MGMT_SCAN_DEPTH dispatchable zones are compared and the write of the group
+ * with the least in-flight writes is taken.
+ */
+static struct request *zinc_stripe_write(struct deadline_data *dd,
+					 struct dd_per_prio *per_prio)
+{
+	unsigned int cursor = dd->write_cursor + 1;
+	struct request *rq, *best = NULL;
+	unsigned int first = UINT_MAX;
+	int best_pending = INT_MAX;
+	int scanned;
+
+	if (cursor >= dd->nr_write_zones)
+		cursor = 0;
+	if (dd->zone_groups <= 1)
+		return zinc_next_write(dd, per_prio, cursor, true);
+
+	for (scanned = 0; scanned < ZINC_MGMT_SCAN_DEPTH; scanned++) {
+		unsigned int zone_no, group;
+		int pending;
+
+		rq = zinc_next_write(dd, per_prio, cursor, true);
+		if (IS_ERR_OR_NULL(rq))
+			return best ?: rq;
+
+		zone_no = zinc_rq_zone_no(rq);
+		if (zone_no == first)
+			break;
+		if (first == UINT_MAX)
+			first = zone_no;
+
+		group = zinc_zone_group(dd, zone_no);
+		pending = atomic_read(&dd->group_pending_requests[group]);
+		if (pending < best_pending) {
+			best = rq;
+			best_pending = pending;
+		}
+		if (!pending)
+			break;
+
+		cursor = zone_no + 1;
+		if (cursor >= dd->nr_write_zones)
+			cursor = 0;
+	}
+
+	return best;
+}
+#else
+static bool zinc_write_plugged(struct deadline_data *dd, struct request *rq)
+{
+	return false;
+}
+
+static struct request *zinc_next_write(struct deadline_data *dd,
+				       struct dd_per_prio *per_prio,
+				       unsigned int zone_no, bool wrap)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static struct request *zinc_stripe_write(struct deadline_data *dd,
+					 struct dd_per_prio *per_prio)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+#endif
+
+/* ZINC: the target zone of @rq is not locked and not plugged, see zinc_write_plugged() */
+static inline bool zinc_write_dispatchable(struct deadline_data *dd,
+					   struct request *rq)
+{
+	return blk_req_can_dispatch_to_zone(rq) && !zinc_write_plugged(dd, rq);
+}
+
 /*
  * For the specified data direction, return the next request to
  * dispatch using arrival ordered lists.
@@ -432,14 +2162,14 @@ static struct request *
 deadline_fifo_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 		      enum dd_data_dir data_dir)
 {
-	struct request *rq;
+	struct request *rq, *next_rq;
 	unsigned long flags;
 
 	if (list_empty(&per_prio->fifo_list[data_dir]))
 		return NULL;
 
 	rq = rq_entry_fifo(per_prio->fifo_list[data_dir].next);
-	if (data_dir == DD_READ || !blk_queue_is_zoned(rq->q))
+	if (data_dir != DD_WRITE || !blk_queue_is_zoned(rq->q))
 		return rq;
 
 	/*
@@ -450,8 +2180,19 @@ deadline_fifo_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 	 * zones and these zones are unlocked.
 	 */
 	spin_lock_irqsave(&dd->zone_lock, flags);
+	/*
+	 * ZINC: if the oldest write can not be dispatched, take the first unlocked zone after
+	 * its zone instead of the oldest dispatchable write.
+	 */
+	if (zinc_write_dispatchable(dd, rq) && blk_queue_nonrot(rq->q))
+		goto out;
+	next_rq = zinc_next_write(dd, per_prio, zinc_rq_zone_no(rq), true);
+	if (!IS_ERR(next_rq)) {
+		rq = next_rq;
+		goto out;
+	}
 	list_for_each_entry(rq, &per_prio->fifo_list[DD_WRITE], queuelist) {
-		if (blk_req_can_dispatch_to_zone(rq) &&
+		if (zinc_write_dispatchable(dd, rq) &&
 		    (blk_queue_nonrot(rq->q) ||
 		     !deadline_is_seq_write(dd, rq)))
 			goto out;
@@ -471,14 +2212,14 @@ static struct request *
 deadline_next_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 		      enum dd_data_dir data_dir)
 {
-	struct request *rq;
+	struct request *rq, *next_rq;
 	unsigned long flags;
 
 	rq = per_prio->next_rq[data_dir];
 	if (!rq)
 		return NULL;
 
-	if (data_dir == DD_READ || !blk_queue_is_zoned(rq->q))
+	if (data_dir != DD_WRITE || !blk_queue_is_zoned(rq->q))
 		return rq;
 
 	/*
@@ -489,8 +2230,19 @@ deadline_next_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 	 * zones and these zones are unlocked.
 	 */
 	spin_lock_irqsave(&dd->zone_lock, flags);
+	if (READ_ONCE(dd->write_striping) && blk_queue_nonrot(rq->q)) {
+		next_rq = zinc_stripe_write(dd, per_prio);
+		if (!IS_ERR(next_rq))
+			rq = next_rq;
+	}
+	if (rq && !zinc_write_dispatchable(dd, rq) && blk_queue_nonrot(rq->q)) {
+		/* ZINC: jump to the next unlocked zone with queued writes */
+		next_rq = zinc_next_write(dd, per_prio, zinc_rq_zone_no(rq), false);
+		if (!IS_ERR(next_rq))
+			rq = next_rq;
+	}
 	while (rq) {
-		if (blk_req_can_dispatch_to_zone(rq))
+		if (zinc_write_dispatchable(dd, rq))
 			break;
 		if (blk_queue_nonrot(rq->q))
 			rq = deadline_latter_request(rq);
@@ -502,6 +2254,31 @@ deadline_next_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 	return rq;
 }
 
+/* ZINC
+ * Select between regular writes and zone appends once the scheduler decided to dispatch a
+ * write. The oldest dispatchable request wins, appends are picked if all regular writes
+ * target locked zones.
+ */
+static enum dd_data_dir zinc_write_dir(struct deadline_data *dd,
+				       struct dd_per_prio *per_prio)
+{
+	struct request *write_rq, *append_rq;
+
+	if (list_empty(&per_prio->fifo_list[DD_APPEND]))
+		return DD_WRITE;
+
+	write_rq = deadline_fifo_request(dd, per_prio, DD_WRITE);
+	if (!write_rq)
+		return DD_APPEND;
+
+	append_rq = rq_entry_fifo(per_prio->fifo_list[DD_APPEND].next);
+	if (time_before((unsigned long)append_rq->fifo_time,
+			(unsigned long)write_rq->fifo_time))
+		return DD_APPEND;
+
+	return DD_WRITE;
+}
+
 /*
  * Returns true if and only if @rq started after @latest_start where
  * @latest_start is in jiffies.
@@ -509,9 +2286,15 @@ deadline_next_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 static bool started_after(struct deadline_data *dd, struct request *rq,
 			  unsigned long latest_start)
 {
+	const enum dd_data_dir data_dir = zinc_data_dir(rq);
 	unsigned long start_time = (unsigned long)rq->fifo_time;
 
-	start_time -= dd->fifo_expire[zinc_data_dir(rq)];
+	/*
+	 * ZINC: zone open/close and other operations are only put on the dispatch list, with
+	 * the insert time as fifo_time and no expire time.
+	 */
+	if (data_dir < DD_DIR_COUNT)
+		start_time -= dd->fifo_expire[data_dir];
 
 	return time_after(start_time, latest_start);
 }
@@ -528,105 +2311,19 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	enum dd_data_dir data_dir;
 	enum dd_prio prio;
 	u8 ioprio_class;
-	int pending_requests = 0;
 
 	lockdep_assert_held(&dd->lock);
 
 	/* ZINC
-	 * If the timer is fired, we first check if we can issue a reset
-	 */
-	if (atomic_cmpxchg(&(dd->reset_timer_fired), 1, 0)) {
-		// dispatch reset
-		pending_requests = atomic_read(&dd->reset_pending_requests);
-
-		// case 0: The number of pending requests is less to the threshold, dispatch
-		if ((!list_empty(&dd->reset_queue)) && 
-		    pending_requests < dd->reset_minimum_concurrency_treshold) {
-			// pr_alert("Pending < Reset \n");
-			rq = list_first_entry(&dd->reset_queue, struct request,
-				      queuelist);
-			list_del_init(&rq->queuelist);
-			atomic_set(&dd->reset_dispatched_write, 0); // Reset the write counter for the next time window
-			goto done;
-		}
-		// case 1: We have dispatched enough write, then dispatch a reset
-		else if ((!list_empty(&dd->reset_queue)) && 
-		   atomic_read(&dd->reset_dispatched_write) > dd->reset_command_tokens) {
-				// pr_alert("Tokens < Reset \n");
-			rq = list_first_entry(&dd->reset_queue, struct request,
-				      queuelist);
-			list_del_init(&rq->queuelist);
-			atomic_set(&dd->reset_dispatched_write, 0); // Reset the write counter for the next time window
-			goto done;
-		}
-		// case 2: We haven't dispatched enough write, but we have a high priority reset
-		else if ((!list_empty(&dd->reset_queue)) && 
-		list_first_entry(&dd->reset_queue, struct request, queuelist)->deadline >= dd->reset_maximum_epoch_holds) {
-				// pr_alert("Reset dispatched \n");
-			rq = list_first_entry(&dd->reset_queue, struct request,
-				      queuelist);
-			list_del_init(&rq->queuelist);
-			atomic_set(&dd->reset_dispatched_write, 0); // Reset the write counter for the next time window
-			goto done;
-		}
-		// case 3: We can not dispatch a reset, then we increment the priority for each pending reset.
-		//         Then continue to dispatch a normal request.
-		list_for_each_entry(rq, &dd->reset_queue, queuelist) {
-					// pr_alert("Reset prio\n");
-			rq->deadline++;
-		}
-
-		//atomic_set(&dd->reset_dispatched_write, 0); // Reset the write counter for the next time window
-	}
-
-
-	/* ZINC
-	 * If the timer is fired, we first check if we can issue a finish
+	 * If the timer is fired, we first check if we can issue a reset, then a finish
 	 */
-	if (atomic_cmpxchg(&(dd->finish_timer_fired), 1, 0)) {
-		// dispatch reset
-		pending_requests = atomic_read(&dd->finish_pending_requests);
-
-		// case 0: The number of pending requests is less to the threshold, dispatch
-		if ((!list_empty(&dd->finish_queue)) && 
-		    pending_requests < dd->finish_minimum_concurrency_treshold) {
-			// pr_alert("Pending < finish min\n");
-			rq = list_first_entry(&dd->finish_queue, struct request,
-				      queuelist);
-			list_del_init(&rq->queuelist);
-			atomic_set(&dd->finish_dispatched_write, 0); // Reset the write counter for the next time window
-			goto done;
-		}
-		// case 1: We have dispatched enough write, then dispatch a finish
-		else if ((!list_empty(&dd->finish_queue)) && 
-		   atomic_read(&dd->finish_dispatched_write) > dd->finish_command_tokens) {
-			// pr_alert("Write < finish tokens\n");
-			rq = list_first_entry(&dd->finish_queue, struct request,
-				      queuelist);
-			list_del_init(&rq->queuelist);
-			atomic_set(&dd->finish_dispatched_write, 0); // Reset the write counter for the next time window
-			goto done;
-		}
-		// case 2: We haven't dispatched enough write, but we have a high priority reset
-		else if ((!list_empty(&dd->finish_queue)) && 
-		list_first_entry(&dd->finish_queue, struct request, queuelist)->deadline >= dd->finish_maximum_epoch_holds) {
-			// pr_alert("Max epoch holds\n");
-			rq = list_first_entry(&dd->finish_queue, struct request,
-				      queuelist);
-			list_del_init(&rq->queuelist);
-			atomic_set(&dd->finish_dispatched_write, 0); // Reset the write counter for the next time window
-			goto done;
-		}
-		// case 3: We can not dispatch a reset, then we increment the priority for each pending reset.
-		//         Then continue to dispatch a normal request.
-		list_for_each_entry(rq, &dd->finish_queue, queuelist) {
-			// pr_alert("Postponing %d\n", rq->deadline);
-			rq->deadline++;
-		}
-
-		//atomic_set(&dd->finish_dispatched_write, 0); // Reset the write counter for the next time window
-	}
+	rq = zinc_mgmt_dispatch(dd, &dd->reset);
+	if (rq)
+		goto done;
 
+	rq = zinc_mgmt_dispatch(dd, &dd->finish);
+	if (rq)
+		goto done;
 
 	if (!list_empty(&per_prio->dispatch)) {
 		rq = list_first_entry(&per_prio->dispatch, struct request,
@@ -653,7 +2350,8 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	if (!list_empty(&per_prio->fifo_list[DD_READ])) {
 		BUG_ON(RB_EMPTY_ROOT(&per_prio->sort_list[DD_READ]));
 
-		if (deadline_fifo_request(dd, per_prio, DD_WRITE) &&
+		if ((deadline_fifo_request(dd, per_prio, DD_WRITE) ||
+		     !list_empty(&per_prio->fifo_list[DD_APPEND])) &&
 		    (dd->starved++ >= dd->writes_starved))
 			goto dispatch_writes;
 
@@ -666,14 +2364,14 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	 * there are either no reads or writes have been starved
 	 */
 
-	if (!list_empty(&per_prio->fifo_list[DD_WRITE])) {
+	if (!list_empty(&per_prio->fifo_list[DD_WRITE]) ||
+	    !list_empty(&per_prio->fifo_list[DD_APPEND])) {
 dispatch_writes:
-		BUG_ON(RB_EMPTY_ROOT(&per_prio->sort_list[DD_WRITE]));
+		data_dir = zinc_write_dir(dd, per_prio);
+		BUG_ON(RB_EMPTY_ROOT(&per_prio->sort_list[data_dir]));
 
 		dd->starved = 0;
 
-		data_dir = DD_WRITE;
-
 		goto dispatch_find_request;
 	}
 
@@ -721,7 +2419,11 @@ dispatch_request:
 done:
 	ioprio_class = dd_rq_ioclass(rq);
 	prio = ioprio_class_to_prio[ioprio_class];
-	dd->per_prio[prio].stats.dispatched++;
+	/* ZINC: management requests are not part of the statistics, see dd_finish_request() */
+	if (zinc_rq(rq)->state == ZINC_RQ_INSERTED)
+		dd->per_prio[prio].stats.dispatched++;
+	if (zinc_data_dir(rq) == DD_WRITE)
+		dd->write_cursor = zinc_rq_zone_no(rq);
 	/*
 	 * If the request needs its target zone locked, do it.
 	 */
@@ -758,6 +2460,191 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
 	return NULL;
 }
 
+/* ZINC
+ * Account a dispatched request for the interference decisions. Staged and passthrough reads
+ * are accounted here as well, so this is not always called with dd->lock held.
+ */
+static void zinc_account_dispatch(struct deadline_data *dd, struct request *rq)
+{
+	const enum dd_data_dir data_dir = zinc_data_dir(rq);
+	const enum dd_prio prio = zinc_rq_prio(rq);
+	unsigned int io_units;
+
+	zinc_track_write_pointer(dd, rq);
+	if (!zinc_is_write_dir(data_dir) && data_dir != ZINC_READ)
+		return;
+
+	// Figure out the I/O size from the request, I/O smaller than 8KiB still counts as 1
+	io_units = zinc_policy_io_units(rq->__data_len);
+
+	/*
+	 * Reads are only charged while a queue considers them. The charged units are kept in
+	 * zinc_rq->charged so that the completion releases exactly what was charged, even if
+	 * the knobs change in between.
+	 */
+	if (data_dir == ZINC_READ) {
+		if (zinc_mgmt_reads_tracked(&dd->reset) ||
+		    zinc_mgmt_reads_tracked(&dd->finish)) {
+			zinc_rq(rq)->charged = io_units;
+			zinc_rq(rq)->charged_read = true;
+			atomic_add(io_units, &dd->reset.per_prio[prio].dispatched_read);
+			atomic_add(io_units, &dd->finish.per_prio[prio].dispatched_read);
+			atomic_add(io_units, &dd->reset.pending_reads);
+			atomic_add(io_units, &dd->finish.pending_reads);
+		}
+		return;
+	}
+
+	/* tokens are only earned for the management requests of the same priority */
+	io_units = zinc_policy_write_cost(dd->write_cost, io_units);
+	zinc_rq(rq)->charged = io_units;
+	zinc_rq(rq)->charged_read = false;
+	atomic_add(io_units, &dd->reset.per_prio[prio].dispatched_write);
+	atomic_add(io_units, &dd->finish.per_prio[prio].dispatched_write);
+	atomic_add(io_units, &dd->reset.pending_requests);
+	atomic_add(io_units, &dd->finish.pending_requests);
+	if (dd->share) {
+		atomic_add(io_units, &dd->share->dispatched_write[0][prio]);
+		atomic_add(io_units, &dd->share->dispatched_write[1][prio]);
+		atomic_add(io_units, &dd->share->pending_requests);
+	}
+	zinc_ops_call(dd, write_dispatch, rq, io_units);
+
+	/* the charged zone group is kept in zinc_rq->group, plus one */
+	if (dd->zone_groups > 1) {
+		unsigned int group = zinc_zone_group(dd, zinc_rq_zone_no(rq));
+
+		zinc_rq(rq)->group = group + 1;
+		atomic_add(io_units, &dd->group_pending_requests[group]);
+	}
+}
+
+/*
+ * ZINC
+ * Release what zinc_account_dispatch() charged for @rq, on completion or requeue. Exactly the
+ * recorded units are released, even if the size of the request changed in between (e.g. a
+ * partial completion), so that the in-flight counters can not drift.
+ */
+static void zinc_release_dispatch(struct deadline_data *dd, struct request *rq)
+{
+	struct zinc_rq *zr = zinc_rq(rq);
+	unsigned int io_units = zr->charged;
+	struct zinc_share *share;
+
+	if (zr->mgmt_inflight) {
+		zr->mgmt_inflight = false;
+		atomic_dec(&zinc_rq_mgmt(dd, rq)->inflight);
+	}
+	if (!io_units)
+		return;
+	zr->charged = 0;
+
+	if (zr->charged_read) {
+		atomic_sub(io_units, &dd->finish.pending_reads);
+		atomic_sub(io_units, &dd->reset.pending_reads);
+		return;
+	}
+
+	/*
+	 * The share is only changed once the local counters dropped to zero, it has to be
+	 * released first, see deadline_share_group_store().
+	 */
+	share = READ_ONCE(dd->share);
+	if (share) {
+		atomic_sub(io_units, &share->pending_requests);
+		smp_mb__after_atomic();
+	}
+	atomic_sub(io_units, &dd->finish.pending_requests);
+	atomic_sub(io_units, &dd->reset.pending_requests);
+	if (zr->group)
+		atomic_sub(io_units, &dd->group_pending_requests[zr->group - 1]);
+	zr->group = 0;
+	zinc_ops_call(dd, write_complete, rq, io_units);
+}
+
+static bool zinc_hctx_has_staged(struct zinc_hctx *zh)
+{
+	enum dd_prio prio;
+
+	if (READ_ONCE(zh->passthrough))
+		return true;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		if (!list_empty_careful(&zh->reads[prio]))
+			return true;
+
+	return false;
+}
+
+/* ZINC
+ * Take all passthrough reads of @zh. Returns the oldest one if nothing else is staged, the
+ * other reads are staged behind the reads that are already staged.
+ */
+static struct request *zinc_take_passthrough(struct zinc_hctx *zh)
+{
+	struct request *rq, *next, *oldest = NULL;
+	LIST_HEAD(reads);
+
+	rq = xchg(&zh->passthrough, NULL);
+	while (rq) {
+		next = rq->rq_next;
+		list_add(&rq->queuelist, &reads);
+		rq = next;
+	}
+
+	if (list_empty(&reads))
+		return NULL;
+
+	spin_lock(&zh->lock);
+	if (list_is_singular(&reads) &&
+	    list_empty(&zh->reads[DD_RT_PRIO]) &&
+	    list_empty(&zh->reads[DD_BE_PRIO])) {
+		oldest = list_first_entry(&reads, struct request, queuelist);
+		list_del_init(&oldest->queuelist);
+	}
+	list_for_each_entry_safe(rq, next, &reads, queuelist) {
+		const enum dd_prio prio = ioprio_class_to_prio[dd_rq_ioclass(rq)];
+
+		list_move_tail(&rq->queuelist, &zh->reads[prio]);
+	}
+	spin_unlock(&zh->lock);
+
+	return oldest;
+}
+
+/* ZINC
+ * Dispatch a staged read of @hctx in priority order, without taking the global lock.
+ */
+static struct request *zinc_dispatch_staged(struct blk_mq_hw_ctx *hctx)
+{
+	struct zinc_hctx *zh = hctx->sched_data;
+	struct request *rq = NULL;
+	enum dd_prio prio;
+
+	if (!zinc_hctx_has_staged(zh))
+		return NULL;
+
+	rq = zinc_take_passthrough(zh);
+	if (rq)
+		goto out;
+
+	spin_lock(&zh->lock);
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		if (!list_empty(&zh->reads[prio])) {
+			rq = list_first_entry(&zh->reads[prio], struct request,
+					      queuelist);
+			list_del_init(&rq->queuelist);
+			break;
+		}
+	}
+	spin_unlock(&zh->lock);
+
+out:
+	if (rq)
+		rq->rq_flags |= RQF_STARTED;
+	return rq;
+}
+
 /*
  * Called from blk_mq_run_hw_queue() -> __blk_mq_sched_dispatch_requests().
  *
@@ -769,10 +2656,26 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
 static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct zinc_hctx *zh = hctx->sched_data;
 	const unsigned long now = jiffies;
 	struct request *rq;
 	enum dd_prio prio;
 
+	/*
+	 * ZINC
+	 * Staged reads go first, but every fifo_batch reads the global queues get a turn so that
+	 * writes and management requests are not starved.
+	 */
+	if (zh->batching < dd->fifo_batch) {
+		rq = zinc_dispatch_staged(hctx);
+		if (rq) {
+			zh->batching++;
+			zinc_account_dispatch(dd, rq);
+			return rq;
+		}
+	}
+	zh->batching = 0;
+
 	spin_lock(&dd->lock);
 	rq = dd_dispatch_prio_aged_requests(dd, now);
 	if (rq)
@@ -789,22 +2692,16 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	}
 
 unlock:
-    if (rq && zinc_data_dir(rq) == ZINC_WRITE) {
-        // Figure out the I/O size from the request
-        unsigned int io_units = (rq->__data_len >> ZINC_IO_SIZE_BIT_SHIFT);	
-
-        // If I/O was smaller than 8KiB, we still count it as 1, since flash page size for us is 8KiB anyways
-        if (io_units < 1u)
-            io_units = 1;
-
-        atomic_add(io_units, &dd->reset_dispatched_write);
-        atomic_add(io_units, &dd->finish_dispatched_write);
-        atomic_add(io_units, &dd->reset_pending_requests);
-        atomic_add(io_units, &dd->finish_pending_requests);
-    }
-
+	if (rq)
+		zinc_account_dispatch(dd, rq);
 	spin_unlock(&dd->lock);
 
+	if (!rq) {
+		rq = zinc_dispatch_staged(hctx);
+		if (rq)
+			zinc_account_dispatch(dd, rq);
+	}
+
 	return rq;
 }
 
@@ -825,9 +2722,43 @@ static void dd_limit_depth(blk_opf_t opf, struct blk_mq_alloc_data *data)
 	 * do not block the allocation of synchronous requests.
 	 */
 	data->shallow_depth = dd->async_depth;
+
+	/* ZINC: resets and finishes may be limited further, to keep tags for writes as well */
+	if (zinc_op_is_mgmt(opf) && dd->mgmt_depth)
+		data->shallow_depth = min_t(u32, dd->async_depth, dd->mgmt_depth);
+}
+
+/* ZINC: the smallest shallow depth set by dd_limit_depth() */
+static unsigned int zinc_min_shallow_depth(struct deadline_data *dd)
+{
+	if (dd->mgmt_depth)
+		return min_t(u32, dd->async_depth, dd->mgmt_depth);
+	return dd->async_depth;
 }
 
 /* Called by blk_mq_update_nr_requests(). */
+/*
+ * ZINC
+ * The scheduler tags may have been reallocated with more tags, grow the per request data to
+ * match. The queue is frozen when the number of requests changes, so no request data is in
+ * use. This can not fail, the allocation falls back to vmalloc.
+ */
+static void zinc_hctx_resize(struct blk_mq_hw_ctx *hctx)
+{
+	struct zinc_hctx *zh = hctx->sched_data;
+	unsigned int nr_rqs = hctx->sched_tags->nr_tags;
+	struct zinc_rq *rqs;
+
+	if (nr_rqs <= zh->nr_rqs)
+		return;
+
+	rqs = kvzalloc_node(array_size(nr_rqs, sizeof(*rqs)),
+			    GFP_KERNEL | __GFP_NOFAIL, hctx->numa_node);
+	kvfree(zh->rqs);
+	zh->rqs = rqs;
+	zh->nr_rqs = nr_rqs;
+}
+
 static void dd_depth_updated(struct blk_mq_hw_ctx *hctx)
 {
 	struct request_queue *q = hctx->queue;
@@ -836,19 +2767,52 @@ static void dd_depth_updated(struct blk_mq_hw_ctx *hctx)
 
 	dd->async_depth = max(1UL, 3 * q->nr_requests / 4);
 
-	sbitmap_queue_min_shallow_depth(&tags->bitmap_tags, dd->async_depth);
+	sbitmap_queue_min_shallow_depth(&tags->bitmap_tags,
+					zinc_min_shallow_depth(dd));
+	zinc_hctx_resize(hctx);
 }
 
 /* Called by blk_mq_init_hctx() and blk_mq_init_sched(). */
 static int dd_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
 {
+	struct zinc_hctx *zh;
+	enum dd_prio prio;
+
+	zh = kzalloc_node(sizeof(*zh), GFP_KERNEL, hctx->numa_node);
+	if (!zh)
+		return -ENOMEM;
+
+	zh->nr_rqs = hctx->sched_tags->nr_tags;
+	zh->rqs = kvzalloc_node(array_size(zh->nr_rqs, sizeof(*zh->rqs)),
+				GFP_KERNEL, hctx->numa_node);
+	if (!zh->rqs) {
+		kfree(zh);
+		return -ENOMEM;
+	}
+
+	spin_lock_init(&zh->lock);
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		INIT_LIST_HEAD(&zh->reads[prio]);
+	hctx->sched_data = zh;
+
 	dd_depth_updated(hctx);
 	return 0;
 }
 
+static void dd_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct zinc_hctx *zh = hctx->sched_data;
+
+	WARN_ON_ONCE(zinc_hctx_has_staged(zh));
+	kvfree(zh->rqs);
+	kfree(zh);
+	hctx->sched_data = NULL;
+}
+
 static void dd_exit_sched(struct elevator_queue *e)
 {
 	struct deadline_data *dd = e->elevator_data;
+	struct zinc_policy_ops *ops;
 	enum dd_prio prio;
 
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
@@ -858,6 +2822,7 @@ static void dd_exit_sched(struct elevator_queue *e)
 
 		WARN_ON_ONCE(!list_empty(&per_prio->fifo_list[DD_READ]));
 		WARN_ON_ONCE(!list_empty(&per_prio->fifo_list[DD_WRITE]));
+		WARN_ON_ONCE(!list_empty(&per_prio->fifo_list[DD_APPEND]));
 
 		spin_lock(&dd->lock);
 		queued = dd_queued(dd, prio);
@@ -869,11 +2834,23 @@ static void dd_exit_sched(struct elevator_queue *e)
 			  stats->dispatched, atomic_read(&stats->completed));
 	}
 
-	// ZINC
-	WARN_ON_ONCE(!list_empty(&dd->reset_queue));
-	WARN_ON_ONCE(!list_empty(&dd->finish_queue));
-	timer_shutdown_sync(&dd->reset_timer);
-	timer_shutdown_sync(&dd->finish_timer);
+	// ZINC: the timers read the share, so they are cancelled before it is dropped
+	hrtimer_cancel(&dd->epoch_timer);
+	hrtimer_cancel(&dd->idle_timer);
+	hrtimer_cancel(&dd->plug_timer);
+	ops = rcu_dereference_protected(dd->policy, true);
+	if (ops)
+		module_put(ops->owner);
+	mutex_lock(&zinc_shares_lock);
+	zinc_share_put(dd->share);
+	WRITE_ONCE(dd->share, NULL);
+	mutex_unlock(&zinc_shares_lock);
+	zinc_mgmt_exit(&dd->reset);
+	zinc_mgmt_exit(&dd->finish);
+	blk_stat_disable_accounting(dd->queue);
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		bitmap_free(dd->per_prio[prio].write_zones);
+	kvfree(dd->zone_wp);
 
 	kfree(dd);
 }
@@ -887,6 +2864,7 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	struct elevator_queue *eq;
 	enum dd_prio prio;
 	int ret = -ENOMEM;
+	int i;
 
 	eq = elevator_alloc(q, e);
 	if (!eq)
@@ -904,11 +2882,14 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 		INIT_LIST_HEAD(&per_prio->dispatch);
 		INIT_LIST_HEAD(&per_prio->fifo_list[DD_READ]);
 		INIT_LIST_HEAD(&per_prio->fifo_list[DD_WRITE]);
+		INIT_LIST_HEAD(&per_prio->fifo_list[DD_APPEND]);
 		per_prio->sort_list[DD_READ] = RB_ROOT;
 		per_prio->sort_list[DD_WRITE] = RB_ROOT;
+		per_prio->sort_list[DD_APPEND] = RB_ROOT;
 	}
 	dd->fifo_expire[DD_READ] = read_expire;
 	dd->fifo_expire[DD_WRITE] = write_expire;
+	dd->fifo_expire[DD_APPEND] = write_expire;
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->last_dir = DD_WRITE;
@@ -916,35 +2897,50 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	dd->prio_aging_expire = prio_aging_expire;
 
     // ZINC
-	INIT_LIST_HEAD(&dd->reset_queue);
-	INIT_LIST_HEAD(&dd->finish_queue);
-	atomic_set(&dd->reset_pending_requests, 0);
-	atomic_set(&dd->finish_pending_requests, 0);
-	atomic_set(&dd->reset_dispatched_write, 0);
-	atomic_set(&dd->finish_dispatched_write, 0);
-	atomic_set(&dd->reset_timer_fired, 0);
-
-	// reset
-	dd->reset_command_tokens = RESET_COMMAND_TOKENS;
-	dd->reset_maximum_epoch_holds = RESET_MAXIMUM_EPOCH_HOLDS;
-	dd->reset_epoch_interval = msecs_to_jiffies(RESET_EPOCH_INTERVAL);
-	if (dd->reset_epoch_interval < 1) {
-		dd->reset_epoch_interval = 1;
-	}
-	dd->reset_minimum_concurrency_treshold = RESET_MINIMUM_CONCURRENCY_THRESHOLD;
-	timer_setup(&dd->reset_timer, zinc_fin_reset_timer_fn, 0);
-	timer_reduce(&dd->reset_timer, jiffies + dd->reset_epoch_interval);
-
-	// finish
-	dd->finish_command_tokens = FINISH_COMMAND_TOKENS;
-	dd->finish_maximum_epoch_holds = FINISH_MAXIMUM_EPOCH_HOLDS;
-	dd->finish_epoch_interval = msecs_to_jiffies(FINISH_EPOCH_INTERVAL);
-	if (dd->finish_epoch_interval < 1) {
-		dd->finish_epoch_interval = 1;
-	}
-	dd->finish_minimum_concurrency_treshold = FINISH_MINIMUM_CONCURRENCY_THRESHOLD;
-	timer_setup(&dd->finish_timer, zinc_fin_finish_timer_fn, 0);
-	timer_reduce(&dd->finish_timer, jiffies + dd->finish_epoch_interval);	
+	dd->queue = q;
+	hrtimer_init(&dd->epoch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	dd->epoch_timer.function = zinc_epoch_timer_fn;
+	atomic_set(&dd->epoch_armed, 0);
+	zinc_mgmt_init(dd, &dd->reset, "reset", RESET_COMMAND_TOKENS,
+		       RESET_MAXIMUM_EPOCH_HOLDS, RESET_EPOCH_INTERVAL,
+		       RESET_MINIMUM_CONCURRENCY_THRESHOLD, RESET_BATCH_SIZE);
+	zinc_mgmt_init(dd, &dd->finish, "finish", FINISH_COMMAND_TOKENS,
+		       FINISH_MAXIMUM_EPOCH_HOLDS, FINISH_EPOCH_INTERVAL,
+		       FINISH_MINIMUM_CONCURRENCY_THRESHOLD, FINISH_BATCH_SIZE);
+	dd->target_write_latency_us = 0;
+	dd->read_staging = 0;
+	dd->read_passthrough = 0;
+	dd->zone_groups = 1;
+	dd->mgmt_coalesce = 0;
+	dd->write_striping = 0;
+	dd->idle_grace_us = 0;
+	dd->share_group = 0;
+	dd->mgmt_depth = 0;
+	dd->share = NULL;
+	RCU_INIT_POINTER(dd->policy, NULL);
+	hrtimer_init(&dd->idle_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dd->idle_timer.function = zinc_idle_timer_fn;
+	dd->write_plug_us = 0;
+	hrtimer_init(&dd->plug_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	dd->plug_timer.function = zinc_plug_timer_fn;
+	for (i = 0; i < ZINC_COST_BUCKETS; i++)
+		dd->write_cost[i] = ZINC_COST_UNIT;
+	dd->adapt.window_end = jiffies;
+	/* The adaptive controller needs the device service time (rq->io_start_time_ns) */
+	blk_stat_enable_accounting(q);
+	/* Without the bitmaps, dispatchable writes are found by walking the queued writes */
+	if (blk_queue_nonrot(q))
+		dd->nr_write_zones = disk_nr_zones(q->disk);
+	for (prio = 0; dd->nr_write_zones && prio <= DD_PRIO_MAX; prio++)
+		dd->per_prio[prio].write_zones =
+			bitmap_zalloc_node(dd->nr_write_zones, GFP_KERNEL, q->node);
+	/* Without write pointers, all management requests cost the full unit */
+	dd->nr_zones = disk_nr_zones(q->disk);
+	if (dd->nr_zones)
+		dd->zone_wp = kvmalloc_node(array_size(dd->nr_zones, sizeof(u32)),
+					    GFP_KERNEL, q->node);
+	if (dd->zone_wp)
+		memset32(dd->zone_wp, ZINC_WP_UNKNOWN, dd->nr_zones);
 
 	spin_lock_init(&dd->lock);
 	spin_lock_init(&dd->zone_lock);
@@ -1003,6 +2999,13 @@ static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 	struct request *free = NULL;
 	bool ret;
 
+	/* ZINC: staged and passthrough reads are not merged, do not take the global lock for them */
+	if (bio_op(bio) == REQ_OP_READ &&
+	    (READ_ONCE(dd->read_staging) ||
+	     (READ_ONCE(dd->read_passthrough) &&
+	      ioprio_class_to_prio[IOPRIO_PRIO_CLASS(bio->bi_ioprio)] != DD_IDLE_PRIO)))
+		return false;
+
 	spin_lock(&dd->lock);
 	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
 	spin_unlock(&dd->lock);
@@ -1026,7 +3029,6 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	u8 ioprio_class = IOPRIO_PRIO_CLASS(ioprio);
 	struct dd_per_prio *per_prio;
 	enum dd_prio prio;
-	int pending_requests = 0;
 	LIST_HEAD(free);
 
 	lockdep_assert_held(&dd->lock);
@@ -1034,44 +3036,30 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	/*
 	 * This may be a requeue of a write request that has locked its
 	 * target zone. If it is the case, this releases the zone lock.
-	//  */
-	// if (blk_req_zone_is_write_locked(rq)) {
-	// 	printk("Requeue \n");
- 	// 	io_units = (rq->__data_len) >> ZINC_IO_SIZE_BIT_SHIFT;		
-	// 	if (io_units < 1u)
-    //         io_units = 1;
-	// 	atomic_sub(io_units, &dd->pending_requests); 
-	// }
+	 * ZINC: a requeued request is no longer in flight, release its charge (normally done
+	 * by dd_requeue_request() already).
+	 */
+	zinc_release_dispatch(dd, rq);
 	blk_req_zone_write_unlock(rq);
 
-	if (data_dir == ZINC_FINISH) {
-		rq->deadline = 0;
-		// pr_alert("Add finish\n");
-		list_add(&rq->queuelist, &dd->finish_queue);
-		// Force timer
-		pending_requests = atomic_read(&dd->finish_pending_requests);
-		if (pending_requests < dd->finish_minimum_concurrency_treshold) {
-			atomic_set(&(dd->finish_timer_fired), 1);
-		}
-		return;
-    }	
-    else if (data_dir > ZINC_WRITE) {
-        rq->deadline = 0;
-		// pr_alert("Add Reset\n");
-        list_add(&rq->queuelist, &dd->reset_queue);
-        // Force timer
-		pending_requests = atomic_read(&dd->reset_pending_requests);
-		if (pending_requests < dd->reset_minimum_concurrency_treshold) {
-			atomic_set(&(dd->reset_timer_fired), 1);
-		}
+	if (data_dir == ZINC_FINISH || zinc_is_reset_dir(data_dir)) {
+		zinc_mgmt_insert(dd, zinc_rq_mgmt(dd, rq), rq);
 		return;
-    } 
+	}
 
 	prio = ioprio_class_to_prio[ioprio_class];
 	per_prio = &dd->per_prio[prio];
-	if (!rq->elv.priv[0]) {
+	if (!zinc_rq(rq)->state) {
 		per_prio->stats.inserted++;
-		rq->elv.priv[0] = (void *)(uintptr_t)1;
+		zinc_rq(rq)->state = ZINC_RQ_INSERTED;
+	}
+
+	/* ZINC: zone open and close are cheap, they are dispatched right away */
+	if (data_dir == ZINC_OPEN_CLOSE) {
+		trace_block_rq_insert(rq);
+		list_add_tail(&rq->queuelist, &per_prio->dispatch);
+		rq->fifo_time = jiffies;
+		return;
 	}
 
 	if (blk_mq_sched_try_insert_merge(q, rq, &free)) {
@@ -1085,7 +3073,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		list_add(&rq->queuelist, &per_prio->dispatch);
 		rq->fifo_time = jiffies;
 	} else {
-		deadline_add_rq_rb(per_prio, rq);
+		deadline_add_rq_rb(dd, per_prio, rq);
 
 		if (rq_mergeable(rq)) {
 			elv_rqhash_add(q, rq);
@@ -1098,9 +3086,66 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		 */
 		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
 		list_add_tail(&rq->queuelist, &per_prio->fifo_list[data_dir]);
+		/*
+		 * ZINC: start of the plug window of the zone, see zinc_write_plugged(). A requeued
+		 * write keeps the stamp of its first insert, it is not plugged a second time.
+		 */
+		if (data_dir == DD_WRITE && !zinc_rq(rq)->plug_start &&
+		    READ_ONCE(dd->write_plug_us))
+			zinc_rq(rq)->plug_start = ktime_get_ns();
 	}
 }
 
+/*
+ * ZINC
+ * Requests that were accounted in the per priority statistics before (e.g. requeued while
+ * staging was disabled) stay on the global queues to keep the statistics balanced.
+ */
+static bool zinc_can_stage(struct request *rq)
+{
+	return zinc_data_dir(rq) == ZINC_READ &&
+		zinc_rq(rq)->state != ZINC_RQ_INSERTED;
+}
+
+/* ZINC: only RT and BE reads in arrival order are passed through */
+static bool zinc_can_passthrough(struct request *rq, blk_insert_t flags)
+{
+	return !(flags & BLK_MQ_INSERT_AT_HEAD) &&
+		ioprio_class_to_prio[dd_rq_ioclass(rq)] != DD_IDLE_PRIO;
+}
+
+/* ZINC: push a read on the lock-free passthrough stack of @hctx */
+static void zinc_passthrough_read(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct zinc_hctx *zh = hctx->sched_data;
+	struct request *head;
+
+	zinc_rq(rq)->state = ZINC_RQ_STAGED;
+	trace_block_rq_insert(rq);
+
+	do {
+		head = READ_ONCE(zh->passthrough);
+		rq->rq_next = head;
+	} while (cmpxchg(&zh->passthrough, head, rq) != head);
+}
+
+static void zinc_stage_read(struct blk_mq_hw_ctx *hctx, struct request *rq,
+			    blk_insert_t flags)
+{
+	struct zinc_hctx *zh = hctx->sched_data;
+	const enum dd_prio prio = ioprio_class_to_prio[dd_rq_ioclass(rq)];
+
+	zinc_rq(rq)->state = ZINC_RQ_STAGED;
+	trace_block_rq_insert(rq);
+
+	spin_lock(&zh->lock);
+	if (flags & BLK_MQ_INSERT_AT_HEAD)
+		list_add(&rq->queuelist, &zh->reads[prio]);
+	else
+		list_add_tail(&rq->queuelist, &zh->reads[prio]);
+	spin_unlock(&zh->lock);
+}
+
 /*
  * Called from blk_mq_sched_insert_request() or blk_mq_sched_insert_requests().
  */
@@ -1110,6 +3155,25 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
+	if (READ_ONCE(dd->read_staging) || READ_ONCE(dd->read_passthrough)) {
+		struct request *rq, *next;
+
+		list_for_each_entry_safe(rq, next, list, queuelist) {
+			if (!zinc_can_stage(rq))
+				continue;
+			if (READ_ONCE(dd->read_passthrough) &&
+			    zinc_can_passthrough(rq, flags)) {
+				list_del_init(&rq->queuelist);
+				zinc_passthrough_read(hctx, rq);
+			} else if (READ_ONCE(dd->read_staging)) {
+				list_del_init(&rq->queuelist);
+				zinc_stage_read(hctx, rq, flags);
+			}
+		}
+		if (list_empty(list))
+			return;
+	}
+
 	spin_lock(&dd->lock);
 	while (!list_empty(list)) {
 		struct request *rq;
@@ -1121,22 +3185,23 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 	spin_unlock(&dd->lock);
 }
 
+/* ZINC: a requeued request is no longer in flight, it is charged again when dispatched */
+static void dd_requeue_request(struct request *rq)
+{
+	struct deadline_data *dd = rq->q->elevator->elevator_data;
+
+	zinc_release_dispatch(dd, rq);
+}
+
 /* Callback from inside blk_mq_rq_ctx_init(). */
 static void dd_prepare_request(struct request *rq)
 {
-	rq->elv.priv[0] = NULL;
+	memset(zinc_rq(rq), 0, sizeof(struct zinc_rq));
 }
 
 static bool dd_has_write_work(struct blk_mq_hw_ctx *hctx)
 {
-	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
-	enum dd_prio p;
-
-	for (p = 0; p <= DD_PRIO_MAX; p++)
-		if (!list_empty_careful(&dd->per_prio[p].fifo_list[DD_WRITE]))
-			return true;
-
-	return false;
+	return zinc_writes_queued(hctx->queue->elevator->elevator_data);
 }
 
 /*
@@ -1162,44 +3227,54 @@ static void dd_finish_request(struct request *rq)
 	const u8 ioprio_class = dd_rq_ioclass(rq);
 	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];
+	struct zinc_rq *zr = zinc_rq(rq);
 	int pending_requests = 0;
-	unsigned int io_units = 0;
+	u64 now = 0;
 
 	/*
 	 * The block layer core may call dd_finish_request() without having
 	 * called dd_insert_requests(). Skip requests that bypassed I/O
 	 * scheduling. See also blk_mq_request_bypass_insert().
 	 */
-	if (!rq->elv.priv[0])
+	if (!zr->state)
 		return;
 
-	atomic_inc(&per_prio->stats.completed);
-
-    // ZINC
-	if (zinc_data_dir(rq) == ZINC_WRITE) {
-		// Instead of the __data_len on finish request this is may no longer be set and the device sets the number of sectors written
-		io_units = (rq->stats_sectors >> ZINC_IO_SIZE_SECTOR_SHIFT);	
+	if (zr->state == ZINC_RQ_INSERTED)
+		atomic_inc(&per_prio->stats.completed);
 
-		// If I/O was smaller than 8KiB, we still count it as 1, since flash page size for us is 8KiB anyways
-		if (io_units < 1u)
-			io_units = 1;
+	if (rq->io_start_time_ns) {
+		now = ktime_get_ns();
+		zinc_hist_sample(dd, rq, now);
+	}
 
-		atomic_sub(io_units, &dd->finish_pending_requests); 
-		atomic_sub(io_units, &dd->reset_pending_requests); 
-		// printk("DECREASE HERE %d %d TYPE %d\n", atomic_read(&zd->pending_requests), io_units, zinc_data_dir(rq));
+    // ZINC
+	zinc_release_dispatch(dd, rq);
+	if (zinc_is_write_dir(zinc_data_dir(rq))) {
+		if (rq->io_start_time_ns)
+			zinc_adapt_sample(dd, now - rq->io_start_time_ns);
 	}  else if (zinc_data_dir(rq) == ZINC_FINISH) {
-		pending_requests = atomic_read(&dd->finish_pending_requests);
-		if (pending_requests < dd->finish_minimum_concurrency_treshold) {
+		pending_requests = zinc_pending_writes(dd);
+		if (pending_requests < dd->finish.minimum_concurrency_treshold) {
 			// printk("Reset fired instantly\n");
-			atomic_set(&(dd->finish_timer_fired), 1);
+			atomic_set(&(dd->finish.timer_fired), 1);
 		}
-	}  else if (zinc_data_dir(rq) > ZINC_WRITE) {
-		pending_requests = atomic_read(&dd->reset_pending_requests);
-		if (pending_requests < dd->reset_minimum_concurrency_treshold) {
+	}  else if (zinc_is_reset_dir(zinc_data_dir(rq))) {
+		pending_requests = zinc_pending_writes(dd);
+		if (pending_requests < dd->reset.minimum_concurrency_treshold) {
 			// printk("Reset fired instantly\n");
-			atomic_set(&(dd->reset_timer_fired), 1);
+			atomic_set(&(dd->reset.timer_fired), 1);
 		}
 	}
+	if (zinc_data_dir(rq) != ZINC_READ)
+		zinc_idle_arm(dd);
+
+	/* ZINC
+	 * A completion can bring the device below the concurrency threshold of a queued
+	 * management request, rerun the queue once this request is freed so it is not
+	 * stuck until the next epoch.
+	 */
+	if (zinc_mgmt_queued(&dd->reset) || zinc_mgmt_queued(&dd->finish))
+		blk_mq_sched_mark_restart_hctx(rq->mq_hctx);
 
 	if (blk_queue_is_zoned(q)) {
 		unsigned long flags;
@@ -1217,7 +3292,8 @@ static bool dd_has_work_for_prio(struct dd_per_prio *per_prio)
 {
 	return !list_empty_careful(&per_prio->dispatch) ||
 		!list_empty_careful(&per_prio->fifo_list[DD_READ]) ||
-		!list_empty_careful(&per_prio->fifo_list[DD_WRITE]);
+		!list_empty_careful(&per_prio->fifo_list[DD_WRITE]) ||
+		!list_empty_careful(&per_prio->fifo_list[DD_APPEND]);
 }
 
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
@@ -1225,15 +3301,18 @@ static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
 	enum dd_prio prio;
 
+	if (zinc_hctx_has_staged(hctx->sched_data))
+		return true;
+
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
 		if (dd_has_work_for_prio(&dd->per_prio[prio]))
 			return true;
 
     // ZINC
-    if (!list_empty(&dd->reset_queue)) {
+    if (zinc_mgmt_queued(&dd->reset)) {
         return true;
     }
-    if (!list_empty(&dd->finish_queue)) {
+    if (zinc_mgmt_queued(&dd->finish)) {
         return true;
     }
 
@@ -1253,21 +3332,55 @@ static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
 #define SHOW_JIFFIES(__FUNC, __VAR) SHOW_INT(__FUNC, jiffies_to_msecs(__VAR))
 SHOW_JIFFIES(deadline_read_expire_show, dd->fifo_expire[DD_READ]);
 SHOW_JIFFIES(deadline_write_expire_show, dd->fifo_expire[DD_WRITE]);
+SHOW_JIFFIES(deadline_append_expire_show, dd->fifo_expire[DD_APPEND]);
 SHOW_JIFFIES(deadline_prio_aging_expire_show, dd->prio_aging_expire);
 SHOW_INT(deadline_writes_starved_show, dd->writes_starved);
 SHOW_INT(deadline_front_merges_show, dd->front_merges);
 SHOW_INT(deadline_async_depth_show, dd->async_depth);
 SHOW_INT(deadline_fifo_batch_show, dd->fifo_batch);
-
-SHOW_INT(deadline_reset_maximum_epoch_holds_show, dd->reset_maximum_epoch_holds);
-SHOW_INT(deadline_reset_command_tokens_show, dd->reset_command_tokens);
-SHOW_JIFFIES(deadline_reset_epoch_interval_show, dd->reset_epoch_interval);
-SHOW_INT(deadline_reset_minimum_concurrency_treshold_show, dd->reset_minimum_concurrency_treshold);
-
-SHOW_INT(deadline_finish_maximum_epoch_holds_show, dd->finish_maximum_epoch_holds);
-SHOW_INT(deadline_finish_command_tokens_show, dd->finish_command_tokens);
-SHOW_JIFFIES(deadline_finish_epoch_interval_show, dd->finish_epoch_interval);
-SHOW_INT(deadline_finish_minimum_concurrency_treshold_show, dd->finish_minimum_concurrency_treshold);
+SHOW_INT(deadline_read_staging_show, dd->read_staging);
+SHOW_INT(deadline_read_passthrough_show, dd->read_passthrough);
+SHOW_INT(deadline_zone_groups_show, dd->zone_groups);
+SHOW_INT(deadline_mgmt_coalesce_show, dd->mgmt_coalesce);
+SHOW_INT(deadline_write_striping_show, dd->write_striping);
+SHOW_INT(deadline_share_group_show, dd->share_group);
+SHOW_INT(deadline_mgmt_depth_show, dd->mgmt_depth);
+SHOW_INT(deadline_write_plug_us_show, dd->write_plug_us);
+SHOW_INT(deadline_reset_max_inflight_show, dd->reset.max_inflight);
+SHOW_INT(deadline_reset_rate_show, dd->reset.rate);
+SHOW_INT(deadline_reset_rate_burst_show, dd->reset.rate_burst);
+SHOW_INT(deadline_reset_rate_writes_show, dd->reset.rate_writes);
+SHOW_INT(deadline_finish_max_inflight_show, dd->finish.max_inflight);
+SHOW_INT(deadline_finish_rate_show, dd->finish.rate);
+SHOW_INT(deadline_finish_rate_burst_show, dd->finish.rate_burst);
+SHOW_INT(deadline_finish_rate_writes_show, dd->finish.rate_writes);
+SHOW_INT(deadline_idle_grace_us_show, dd->idle_grace_us);
+
+SHOW_INT(deadline_reset_maximum_epoch_holds_show, dd->reset.maximum_epoch_holds);
+SHOW_INT(deadline_reset_command_tokens_show, dd->reset.command_tokens);
+SHOW_INT(deadline_reset_epoch_interval_show, dd->reset.epoch_interval_us / (int)USEC_PER_MSEC);
+SHOW_INT(deadline_reset_epoch_interval_us_show, dd->reset.epoch_interval_us);
+SHOW_INT(deadline_reset_minimum_concurrency_treshold_show, dd->reset.minimum_concurrency_treshold);
+SHOW_INT(deadline_reset_batch_size_show, dd->reset.batch_size);
+SHOW_INT(deadline_reset_read_command_tokens_show, dd->reset.read_command_tokens);
+SHOW_INT(deadline_reset_minimum_read_concurrency_treshold_show, dd->reset.minimum_read_concurrency_treshold);
+SHOW_INT(deadline_reset_min_cost_show, dd->reset.min_cost);
+SHOW_INT(deadline_reset_urgent_show, dd->reset.urgent);
+SHOW_INT(deadline_reset_urgent_queue_depth_show, dd->reset.urgent_queue_depth);
+SHOW_INT(deadline_reset_urgent_epoch_holds_show, dd->reset.urgent_epoch_holds);
+
+SHOW_INT(deadline_finish_maximum_epoch_holds_show, dd->finish.maximum_epoch_holds);
+SHOW_INT(deadline_finish_command_tokens_show, dd->finish.command_tokens);
+SHOW_INT(deadline_finish_epoch_interval_show, dd->finish.epoch_interval_us / (int)USEC_PER_MSEC);
+SHOW_INT(deadline_finish_epoch_interval_us_show, dd->finish.epoch_interval_us);
+SHOW_INT(deadline_finish_minimum_concurrency_treshold_show, dd->finish.minimum_concurrency_treshold);
+SHOW_INT(deadline_finish_batch_size_show, dd->finish.batch_size);
+SHOW_INT(deadline_finish_read_command_tokens_show, dd->finish.read_command_tokens);
+SHOW_INT(deadline_finish_minimum_read_concurrency_treshold_show, dd->finish.minimum_read_concurrency_treshold);
+SHOW_INT(deadline_finish_min_cost_show, dd->finish.min_cost);
+SHOW_INT(deadline_finish_urgent_show, dd->finish.urgent);
+SHOW_INT(deadline_finish_urgent_queue_depth_show, dd->finish.urgent_queue_depth);
+SHOW_INT(deadline_finish_urgent_epoch_holds_show, dd->finish.urgent_epoch_holds);
 
 #undef SHOW_INT
 #undef SHOW_JIFFIES
@@ -1292,27 +3405,325 @@ static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)
 	STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, )
 #define STORE_JIFFIES(__FUNC, __PTR, MIN, MAX)				\
 	STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, msecs_to_jiffies)
+#define zinc_msecs_to_usecs(__ms) max((__ms) * (int)USEC_PER_MSEC, ZINC_MIN_EPOCH_INTERVAL)
+#define STORE_MSECS_AS_USECS(__FUNC, __PTR, MIN, MAX)			\
+	STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, zinc_msecs_to_usecs)
 STORE_JIFFIES(deadline_read_expire_store, &dd->fifo_expire[DD_READ], 0, INT_MAX);
 STORE_JIFFIES(deadline_write_expire_store, &dd->fifo_expire[DD_WRITE], 0, INT_MAX);
+STORE_JIFFIES(deadline_append_expire_store, &dd->fifo_expire[DD_APPEND], 0, INT_MAX);
 STORE_JIFFIES(deadline_prio_aging_expire_store, &dd->prio_aging_expire, 0, INT_MAX);
 STORE_INT(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX);
 STORE_INT(deadline_front_merges_store, &dd->front_merges, 0, 1);
 STORE_INT(deadline_async_depth_store, &dd->async_depth, 1, INT_MAX);
 STORE_INT(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX);
-
-STORE_INT(deadline_reset_maximum_epoch_holds_store, &dd->reset_maximum_epoch_holds, 0, INT_MAX);
-STORE_INT(deadline_reset_command_tokens_store, &dd->reset_command_tokens, 0, INT_MAX);
-STORE_JIFFIES(deadline_reset_epoch_interval_store, &dd->reset_epoch_interval, 0, INT_MAX);
-STORE_INT(deadline_reset_minimum_concurrency_treshold_store, &dd->reset_minimum_concurrency_treshold, 0, INT_MAX);
-
-STORE_INT(deadline_finish_maximum_epoch_holds_store, &dd->finish_maximum_epoch_holds, 0, INT_MAX);
-STORE_INT(deadline_finish_command_tokens_store, &dd->finish_command_tokens, 0, INT_MAX);
-STORE_JIFFIES(deadline_finish_epoch_interval_store, &dd->finish_epoch_interval, 0, INT_MAX);
-STORE_INT(deadline_finish_minimum_concurrency_treshold_store, &dd->finish_minimum_concurrency_treshold, 0, INT_MAX);
+STORE_INT(deadline_zone_groups_store, &dd->zone_groups, 1, ZINC_MAX_ZONE_GROUPS);
+STORE_INT(deadline_mgmt_coalesce_store, &dd->mgmt_coalesce, 0, 1);
+STORE_INT(deadline_write_striping_store, &dd->write_striping, 0, 1);
+STORE_INT(deadline_idle_grace_us_store, &dd->idle_grace_us, 0, INT_MAX);
+STORE_INT(deadline_write_plug_us_store, &dd->write_plug_us, 0, INT_MAX);
+STORE_INT(deadline_reset_max_inflight_store, &dd->reset.max_inflight, 0, INT_MAX);
+STORE_INT(deadline_reset_rate_store, &dd->reset.rate, 0, INT_MAX);
+STORE_INT(deadline_reset_rate_burst_store, &dd->reset.rate_burst, 1, INT_MAX);
+STORE_INT(deadline_reset_rate_writes_store, &dd->reset.rate_writes, 0, 1);
+STORE_INT(deadline_finish_max_inflight_store, &dd->finish.max_inflight, 0, INT_MAX);
+STORE_INT(deadline_finish_rate_store, &dd->finish.rate, 0, INT_MAX);
+STORE_INT(deadline_finish_rate_burst_store, &dd->finish.rate_burst, 1, INT_MAX);
+STORE_INT(deadline_finish_rate_writes_store, &dd->finish.rate_writes, 0, 1);
+
+STORE_INT(deadline_reset_maximum_epoch_holds_store, &dd->reset.maximum_epoch_holds, 0, INT_MAX);
+STORE_INT(deadline_reset_command_tokens_store, &dd->reset.command_tokens, 0, INT_MAX);
+STORE_MSECS_AS_USECS(deadline_reset_epoch_interval_store, &dd->reset.epoch_interval_us, 0, INT_MAX / USEC_PER_MSEC);
+STORE_INT(deadline_reset_epoch_interval_us_store, &dd->reset.epoch_interval_us, ZINC_MIN_EPOCH_INTERVAL, INT_MAX);
+STORE_INT(deadline_reset_minimum_concurrency_treshold_store, &dd->reset.minimum_concurrency_treshold, 0, INT_MAX);
+STORE_INT(deadline_reset_batch_size_store, &dd->reset.batch_size, 1, INT_MAX);
+STORE_INT(deadline_reset_read_command_tokens_store, &dd->reset.read_command_tokens, 0, INT_MAX);
+STORE_INT(deadline_reset_minimum_read_concurrency_treshold_store, &dd->reset.minimum_read_concurrency_treshold, 0, INT_MAX);
+STORE_INT(deadline_reset_min_cost_store, &dd->reset.min_cost, 0, ZINC_COST_UNIT);
+STORE_INT(deadline_reset_urgent_store, &dd->reset.urgent, 0, 1);
+STORE_INT(deadline_reset_urgent_queue_depth_store, &dd->reset.urgent_queue_depth, 0, INT_MAX);
+STORE_INT(deadline_reset_urgent_epoch_holds_store, &dd->reset.urgent_epoch_holds, 0, INT_MAX);
+
+STORE_INT(deadline_finish_maximum_epoch_holds_store, &dd->finish.maximum_epoch_holds, 0, INT_MAX);
+STORE_INT(deadline_finish_command_tokens_store, &dd->finish.command_tokens, 0, INT_MAX);
+STORE_MSECS_AS_USECS(deadline_finish_epoch_interval_store, &dd->finish.epoch_interval_us, 0, INT_MAX / USEC_PER_MSEC);
+STORE_INT(deadline_finish_epoch_interval_us_store, &dd->finish.epoch_interval_us, ZINC_MIN_EPOCH_INTERVAL, INT_MAX);
+STORE_INT(deadline_finish_minimum_concurrency_treshold_store, &dd->finish.minimum_concurrency_treshold, 0, INT_MAX);
+STORE_INT(deadline_finish_batch_size_store, &dd->finish.batch_size, 1, INT_MAX);
+STORE_INT(deadline_finish_read_command_tokens_store, &dd->finish.read_command_tokens, 0, INT_MAX);
+STORE_INT(deadline_finish_minimum_read_concurrency_treshold_store, &dd->finish.minimum_read_concurrency_treshold, 0, INT_MAX);
+STORE_INT(deadline_finish_min_cost_store, &dd->finish.min_cost, 0, ZINC_COST_UNIT);
+STORE_INT(deadline_finish_urgent_store, &dd->finish.urgent, 0, 1);
+STORE_INT(deadline_finish_urgent_queue_depth_store, &dd->finish.urgent_queue_depth, 0, INT_MAX);
+STORE_INT(deadline_finish_urgent_epoch_holds_store, &dd->finish.urgent_epoch_holds, 0, INT_MAX);
 
 #undef STORE_FUNCTION
 #undef STORE_INT
 #undef STORE_JIFFIES
+#undef STORE_MSECS_AS_USECS
+#undef zinc_msecs_to_usecs
+
+/* ZINC: the write cost weights in percent, from the 8KiB bucket up to the 1MiB and larger bucket */
+static ssize_t deadline_write_cost_weights_show(struct elevator_queue *e,
+						char *page)
+{
+	struct deadline_data *dd = e->elevator_data;
+	ssize_t len = 0;
+	int bucket;
+
+	for (bucket = 0; bucket < ZINC_COST_BUCKETS; bucket++)
+		len += sysfs_emit_at(page, len, "%d%c", dd->write_cost[bucket],
+				     bucket == ZINC_COST_BUCKETS - 1 ? '\n' : ' ');
+	return len;
+}
+
+/* ZINC: all ZINC_COST_BUCKETS weights are written at once, separated by spaces */
+static ssize_t deadline_write_cost_weights_store(struct elevator_queue *e,
+						 const char *page,
+						 size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	int weights[ZINC_COST_BUCKETS];
+	int bucket = 0, ret = 0;
+	char *buf, *pos, *tok;
+
+	buf = kstrndup(page, count, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	pos = strim(buf);
+	while ((tok = strsep(&pos, " \t"))) {
+		if (!*tok)
+			continue;
+		if (bucket == ZINC_COST_BUCKETS) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = kstrtoint(tok, 0, &weights[bucket]);
+		if (ret < 0)
+			break;
+		weights[bucket] = clamp(weights[bucket], 1, ZINC_MAX_COST);
+		bucket++;
+	}
+	kfree(buf);
+	if (!ret && bucket != ZINC_COST_BUCKETS)
+		ret = -EINVAL;
+	if (ret < 0)
+		return ret;
+
+	for (bucket = 0; bucket < ZINC_COST_BUCKETS; bucket++)
+		WRITE_ONCE(dd->write_cost[bucket], weights[bucket]);
+	return count;
+}
+
+/*
+ * ZINC: join share group @id, 0 leaves the share group, ZINC_SHARE_CONTROLLER joins the group
+ * of the controller. The in-flight writes were charged to the old group, so the group can only
+ * be changed while no write is in flight.
+ */
+static ssize_t deadline_share_group_store(struct elevator_queue *e,
+					  const char *page, size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	struct zinc_share *share = NULL, *old;
+	struct device *controller = NULL;
+	int id, ret;
+
+	ret = kstrtoint(page, 0, &id);
+	if (ret < 0)
+		return ret;
+	if (id < ZINC_SHARE_CONTROLLER)
+		return -EINVAL;
+	if (id == ZINC_SHARE_CONTROLLER) {
+		controller = disk_to_dev(dd->queue->disk)->parent;
+		if (!controller)
+			return -ENODEV;
+	}
+
+	mutex_lock(&zinc_shares_lock);
+	if (id) {
+		share = zinc_share_get(controller, id);
+		if (!share) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+	}
+
+	spin_lock(&dd->lock);
+	if (atomic_read(&dd->reset.pending_requests)) {
+		spin_unlock(&dd->lock);
+		zinc_share_put(share);
+		ret = -EBUSY;
+		goto unlock;
+	}
+	old = dd->share;
+	WRITE_ONCE(dd->share, share);
+	dd->share_group = id;
+	spin_unlock(&dd->lock);
+
+	zinc_share_put(old);
+	ret = count;
+unlock:
+	mutex_unlock(&zinc_shares_lock);
+	return ret;
+}
+
+/* ZINC: the tag allocator needs to know the smallest shallow depth, see dd_depth_updated() */
+static ssize_t deadline_mgmt_depth_store(struct elevator_queue *e,
+					 const char *page, size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long i;
+	int depth, ret;
+
+	ret = kstrtoint(page, 0, &depth);
+	if (ret < 0)
+		return ret;
+	if (depth < 0)
+		return -EINVAL;
+
+	WRITE_ONCE(dd->mgmt_depth, depth);
+	queue_for_each_hw_ctx(dd->queue, hctx, i)
+		sbitmap_queue_min_shallow_depth(&hctx->sched_tags->bitmap_tags,
+						zinc_min_shallow_depth(dd));
+	return count;
+}
+
+/* ZINC: the registered policies, the selected one in brackets */
+static ssize_t deadline_policy_show(struct elevator_queue *e, char *page)
+{
+	struct deadline_data *dd = e->elevator_data;
+	struct zinc_policy_ops *ops, *selected;
+	ssize_t len;
+
+	mutex_lock(&zinc_policies_lock);
+	rcu_read_lock();
+	selected = rcu_dereference(dd->policy);
+	len = sysfs_emit(page, selected ? "default" : "[default]");
+	list_for_each_entry(ops, &zinc_policies, list)
+		len += sysfs_emit_at(page, len, ops == selected ? " [%s]" : " %s",
+				     ops->name);
+	rcu_read_unlock();
+	mutex_unlock(&zinc_policies_lock);
+	len += sysfs_emit_at(page, len, "\n");
+
+	return len;
+}
+
+/*
+ * ZINC: select a registered policy by name, or the built-in one with "default". The old policy
+ * is only released once no hook can be running anymore.
+ */
+static ssize_t deadline_policy_store(struct elevator_queue *e,
+				     const char *page, size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	struct zinc_policy_ops *ops = NULL, *old;
+	char name[ZINC_POLICY_NAME_MAX];
+
+	strscpy(name, page, sizeof(name));
+	strim(name);
+	if (strcmp(name, "default")) {
+		mutex_lock(&zinc_policies_lock);
+		ops = zinc_ops_find(name);
+		if (ops && !try_module_get(ops->owner))
+			ops = NULL;
+		mutex_unlock(&zinc_policies_lock);
+		if (!ops)
+			return -EINVAL;
+	}
+
+	spin_lock(&dd->lock);
+	old = rcu_dereference_protected(dd->policy, lockdep_is_held(&dd->lock));
+	rcu_assign_pointer(dd->policy, ops);
+	spin_unlock(&dd->lock);
+
+	if (old) {
+		synchronize_rcu();
+		module_put(old->owner);
+	}
+	return count;
+}
+
+static ssize_t deadline_target_write_latency_us_show(struct elevator_queue *e,
+						     char *page)
+{
+	struct deadline_data *dd = e->elevator_data;
+
+	return sysfs_emit(page, "%d\n", dd->target_write_latency_us);
+}
+
+/* Changing the target restarts the adaptive controller from the configured knobs. */
+static ssize_t deadline_target_write_latency_us_store(struct elevator_queue *e,
+						      const char *page,
+						      size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	int __data, __ret;
+
+	__ret = kstrtoint(page, 0, &__data);
+	if (__ret < 0)
+		return __ret;
+	if (__data < 0)
+		__data = 0;
+
+	WRITE_ONCE(dd->target_write_latency_us, __data);
+	zinc_adapt_set_scale(dd, ZINC_ADAPT_SCALE_UNIT);
+	return count;
+}
+
+/*
+ * Staged and passthrough reads are dispatched from the hardware queue they were inserted in, so
+ * every hardware queue has to be run instead of a single one while either mode is enabled.
+ * Once both are disabled, reads may still be staged or on the passthrough stack of any hardware
+ * queue. The queue is frozen to drain them while every hardware queue is still run, before a
+ * single one is run again.
+ */
+static void zinc_set_read_bypass(struct deadline_data *dd, int *mode, int val)
+{
+	struct request_queue *q = dd->queue;
+
+	if (val)
+		blk_queue_flag_clear(QUEUE_FLAG_SQ_SCHED, q);
+	WRITE_ONCE(*mode, val);
+	if (READ_ONCE(dd->read_staging) || READ_ONCE(dd->read_passthrough) ||
+	    blk_queue_sq_sched(q))
+		return;
+
+	blk_mq_freeze_queue(q);
+	blk_queue_flag_set(QUEUE_FLAG_SQ_SCHED, q);
+	blk_mq_unfreeze_queue(q);
+}
+
+static ssize_t deadline_read_staging_store(struct elevator_queue *e,
+					   const char *page, size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	int __data, __ret;
+
+	__ret = kstrtoint(page, 0, &__data);
+	if (__ret < 0)
+		return __ret;
+	__data = clamp(__data, 0, 1);
+
+	zinc_set_read_bypass(dd, &dd->read_staging, __data);
+	return count;
+}
+
+static ssize_t deadline_read_passthrough_store(struct elevator_queue *e,
+					       const char *page, size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	int __data, __ret;
+
+	__ret = kstrtoint(page, 0, &__data);
+	if (__ret < 0)
+		return __ret;
+	__data = clamp(__data, 0, 1);
+
+	zinc_set_read_bypass(dd, &dd->read_passthrough, __data);
+	return count;
+}
 
 #define DD_ATTR(name) \
 	__ATTR(name, 0644, deadline_##name##_show, deadline_##name##_store)
@@ -1320,6 +3731,7 @@ STORE_INT(deadline_finish_minimum_concurrency_treshold_store, &dd->finish_minimu
 static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(read_expire),
 	DD_ATTR(write_expire),
+	DD_ATTR(append_expire),
 	DD_ATTR(writes_starved),
 	DD_ATTR(front_merges),
 	DD_ATTR(async_depth),
@@ -1328,11 +3740,47 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(reset_maximum_epoch_holds),
 	DD_ATTR(reset_command_tokens),
 	DD_ATTR(reset_epoch_interval),
+	DD_ATTR(reset_epoch_interval_us),
 	DD_ATTR(reset_minimum_concurrency_treshold),
+	DD_ATTR(reset_batch_size),
+	DD_ATTR(reset_read_command_tokens),
+	DD_ATTR(reset_minimum_read_concurrency_treshold),
+	DD_ATTR(reset_min_cost),
+	DD_ATTR(reset_urgent),
+	DD_ATTR(reset_urgent_queue_depth),
+	DD_ATTR(reset_urgent_epoch_holds),
 	DD_ATTR(finish_maximum_epoch_holds),
 	DD_ATTR(finish_command_tokens),
 	DD_ATTR(finish_epoch_interval),
+	DD_ATTR(finish_epoch_interval_us),
 	DD_ATTR(finish_minimum_concurrency_treshold),
+	DD_ATTR(finish_batch_size),
+	DD_ATTR(finish_read_command_tokens),
+	DD_ATTR(finish_minimum_read_concurrency_treshold),
+	DD_ATTR(finish_min_cost),
+	DD_ATTR(finish_urgent),
+	DD_ATTR(finish_urgent_queue_depth),
+	DD_ATTR(finish_urgent_epoch_holds),
+	DD_ATTR(target_write_latency_us),
+	DD_ATTR(read_staging),
+	DD_ATTR(read_passthrough),
+	DD_ATTR(zone_groups),
+	DD_ATTR(mgmt_coalesce),
+	DD_ATTR(write_striping),
+	DD_ATTR(idle_grace_us),
+	DD_ATTR(write_cost_weights),
+	DD_ATTR(share_group),
+	DD_ATTR(mgmt_depth),
+	DD_ATTR(write_plug_us),
+	DD_ATTR(reset_max_inflight),
+	DD_ATTR(reset_rate),
+	DD_ATTR(reset_rate_burst),
+	DD_ATTR(reset_rate_writes),
+	DD_ATTR(finish_max_inflight),
+	DD_ATTR(finish_rate),
+	DD_ATTR(finish_rate_burst),
+	DD_ATTR(finish_rate_writes),
+	DD_ATTR(policy),
 	__ATTR_NULL
 };
 
@@ -1391,10 +3839,13 @@ static int deadline_##name##_next_rq_show(void *data,			\
 
 DEADLINE_DEBUGFS_DDIR_ATTRS(DD_RT_PRIO, DD_READ, read0);
 DEADLINE_DEBUGFS_DDIR_ATTRS(DD_RT_PRIO, DD_WRITE, write0);
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_RT_PRIO, DD_APPEND, append0);
 DEADLINE_DEBUGFS_DDIR_ATTRS(DD_BE_PRIO, DD_READ, read1);
 DEADLINE_DEBUGFS_DDIR_ATTRS(DD_BE_PRIO, DD_WRITE, write1);
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_BE_PRIO, DD_APPEND, append1);
 DEADLINE_DEBUGFS_DDIR_ATTRS(DD_IDLE_PRIO, DD_READ, read2);
 DEADLINE_DEBUGFS_DDIR_ATTRS(DD_IDLE_PRIO, DD_WRITE, write2);
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_IDLE_PRIO, DD_APPEND, append2);
 #undef DEADLINE_DEBUGFS_DDIR_ATTRS
 
 static int deadline_batching_show(void *data, struct seq_file *m)
@@ -1513,6 +3964,194 @@ DEADLINE_DISPATCH_ATTR(1);
 DEADLINE_DISPATCH_ATTR(2);
 #undef DEADLINE_DISPATCH_ATTR
 
+/* ZINC: queued management requests, prefixed with their zone and epoch holds */
+static int zinc_mgmt_rq_show(struct seq_file *m, void *v)
+{
+	struct request *rq = list_entry(v, struct request, queuelist);
+	struct request_queue *q = m->private;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	struct zinc_mgmt *zm = zinc_rq_mgmt(dd, rq);
+
+	seq_printf(m, "zone=%u holds=%u cost=%u ", zinc_rq_zone_no(rq),
+		   zinc_mgmt_holds(&zm->per_prio[zinc_rq_prio(rq)], rq),
+		   zinc_mgmt_cost(dd, zm, rq));
+	return __blk_mq_debugfs_rq_show(m, rq);
+}
+
+#define ZINC_MGMT_QUEUE_ATTR(op, prio)					\
+static void *zinc_##op##prio##_queue_start(struct seq_file *m,		\
+					   loff_t *pos)			\
+	__acquires(&dd->lock)						\
+{									\
+	struct request_queue *q = m->private;				\
+	struct deadline_data *dd = q->elevator->elevator_data;		\
+									\
+	spin_lock(&dd->lock);						\
+	return seq_list_start(&dd->op.per_prio[prio].queue, *pos);	\
+}									\
+									\
+static void *zinc_##op##prio##_queue_next(struct seq_file *m,		\
+					  void *v, loff_t *pos)		\
+{									\
+	struct request_queue *q = m->private;				\
+	struct deadline_data *dd = q->elevator->elevator_data;		\
+									\
+	return seq_list_next(v, &dd->op.per_prio[prio].queue, pos);	\
+}									\
+									\
+static void zinc_##op##prio##_queue_stop(struct seq_file *m, void *v)	\
+	__releases(&dd->lock)						\
+{									\
+	struct request_queue *q = m->private;				\
+	struct deadline_data *dd = q->elevator->elevator_data;		\
+									\
+	spin_unlock(&dd->lock);						\
+}									\
+									\
+static const struct seq_operations zinc_##op##prio##_queue_seq_ops = {	\
+	.start	= zinc_##op##prio##_queue_start,			\
+	.next	= zinc_##op##prio##_queue_next,				\
+	.stop	= zinc_##op##prio##_queue_stop,				\
+	.show	= zinc_mgmt_rq_show,					\
+}
+
+ZINC_MGMT_QUEUE_ATTR(reset, 0);
+ZINC_MGMT_QUEUE_ATTR(reset, 1);
+ZINC_MGMT_QUEUE_ATTR(reset, 2);
+ZINC_MGMT_QUEUE_ATTR(finish, 0);
+ZINC_MGMT_QUEUE_ATTR(finish, 1);
+ZINC_MGMT_QUEUE_ATTR(finish, 2);
+#undef ZINC_MGMT_QUEUE_ATTR
+
+static void zinc_mgmt_stats_show(struct seq_file *m, struct zinc_mgmt *zm)
+{
+	enum dd_prio prio;
+
+	seq_printf(m, "%s_queued %u\n", zm->name, zm->nr_queued);
+	seq_printf(m, "%s_batch_left %u\n", zm->name, zm->batch_left);
+	seq_printf(m, "%s_inflight %d\n", zm->name, atomic_read(&zm->inflight));
+	if (zm->rate)
+		seq_printf(m, "%s_bucket_milliops %llu\n", zm->name,
+			   div_u64(zm->bucket, ZINC_BUCKET_OP / 1000));
+	seq_printf(m, "%s_timer_fired %d\n", zm->name,
+		   atomic_read(&zm->timer_fired));
+	seq_printf(m, "%s_pending_requests %d\n", zm->name,
+		   atomic_read(&zm->pending_requests));
+	seq_printf(m, "%s_pending_reads %d\n", zm->name,
+		   atomic_read(&zm->pending_reads));
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		struct zinc_mgmt_prio *zmp = &zm->per_prio[prio];
+
+		seq_printf(m, "%s%d_epoch %u\n", zm->name, prio, zmp->epoch);
+		seq_printf(m, "%s%d_dispatched_write %d\n", zm->name, prio,
+			   atomic_read(&zmp->dispatched_write));
+		seq_printf(m, "%s%d_dispatched_read %d\n", zm->name, prio,
+			   atomic_read(&zmp->dispatched_read));
+	}
+	seq_printf(m, "%s_case_idle %lu\n", zm->name, zm->cases[ZINC_CASE_IDLE]);
+	seq_printf(m, "%s_case_tokens %lu\n", zm->name, zm->cases[ZINC_CASE_TOKENS]);
+	seq_printf(m, "%s_case_holds %lu\n", zm->name, zm->cases[ZINC_CASE_HOLDS]);
+	seq_printf(m, "%s_case_urgent %lu\n", zm->name, zm->cases[ZINC_CASE_URGENT]);
+	seq_printf(m, "%s_case_policy %lu\n", zm->name, zm->cases[ZINC_CASE_POLICY]);
+	seq_printf(m, "%s_case_postpone %lu\n", zm->name,
+		   zm->cases[ZINC_CASE_POSTPONE]);
+	seq_printf(m, "%s_idle_left %u\n", zm->name, zm->idle_left);
+	seq_printf(m, "%s_idle_issued %lu\n", zm->name, zm->idle_issued);
+	seq_printf(m, "%s_coalesced %lu\n", zm->name, zm->coalesced);
+}
+
+static int zinc_stats_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+
+	spin_lock(&dd->lock);
+	seq_printf(m, "epoch_timer_armed %d\n", atomic_read(&dd->epoch_armed));
+	if (dd->share) {
+		seq_printf(m, "share_members %d\n", READ_ONCE(dd->share->members));
+		seq_printf(m, "share_pending_requests %d\n",
+			   atomic_read(&dd->share->pending_requests));
+	}
+	zinc_mgmt_stats_show(m, &dd->reset);
+	zinc_mgmt_stats_show(m, &dd->finish);
+	spin_unlock(&dd->lock);
+
+	return 0;
+}
+
+/*
+ * ZINC
+ * Compare the in-flight counters with the charges recorded for the requests that are in
+ * flight. The requests are not frozen, so small differences are expected while I/O is
+ * running, a difference that persists on an idle device is drift.
+ */
+static int zinc_accounting_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	s64 writes = 0, reads = 0, groups = 0;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long i;
+	unsigned int tag;
+	int group;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		struct zinc_hctx *zh = hctx->sched_data;
+
+		for (tag = 0; zh && tag < zh->nr_rqs; tag++) {
+			struct zinc_rq *zr = &zh->rqs[tag];
+			unsigned int charged = READ_ONCE(zr->charged);
+
+			if (READ_ONCE(zr->charged_read)) {
+				reads += charged;
+				continue;
+			}
+			writes += charged;
+			if (READ_ONCE(zr->group))
+				groups += charged;
+		}
+	}
+
+	seq_printf(m, "reset_pending_requests %d charged %lld\n",
+		   atomic_read(&dd->reset.pending_requests), writes);
+	seq_printf(m, "finish_pending_requests %d charged %lld\n",
+		   atomic_read(&dd->finish.pending_requests), writes);
+	seq_printf(m, "reset_pending_reads %d charged %lld\n",
+		   atomic_read(&dd->reset.pending_reads), reads);
+	seq_printf(m, "finish_pending_reads %d charged %lld\n",
+		   atomic_read(&dd->finish.pending_reads), reads);
+	for (group = 0; group < ZINC_MAX_ZONE_GROUPS; group++)
+		groups -= atomic_read(&dd->group_pending_requests[group]);
+	seq_printf(m, "group_pending_requests drift %lld\n", -groups);
+
+	return 0;
+}
+
+/* ZINC: one line per bucket, the upper bound in us followed by the wait and service counts */
+#define ZINC_HIST_ATTR(name, op)					\
+static int zinc_##name##_hist_show(void *data, struct seq_file *m)	\
+{									\
+	struct request_queue *q = data;					\
+	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct zinc_hist *zh = &dd->hist;				\
+	unsigned int i;							\
+									\
+	for (i = 0; i < ZINC_HIST_BUCKETS; i++) {			\
+		if (i == ZINC_HIST_BUCKETS - 1)				\
+			seq_puts(m, "max");				\
+		else							\
+			seq_printf(m, "%llu", 1ULL << i);		\
+		seq_printf(m, " %d %d\n", atomic_read(&zh->wait[op][i]),	\
+			   atomic_read(&zh->service[op][i]));		\
+	}								\
+	return 0;							\
+}
+ZINC_HIST_ATTR(read, ZINC_HIST_READ);
+ZINC_HIST_ATTR(write, ZINC_HIST_WRITE);
+ZINC_HIST_ATTR(reset, ZINC_HIST_RESET);
+ZINC_HIST_ATTR(finish, ZINC_HIST_FINISH);
+#undef ZINC_HIST_ATTR
+
 #define DEADLINE_QUEUE_DDIR_ATTRS(name)					\
 	{#name "_fifo_list", 0400,					\
 			.seq_ops = &deadline_##name##_fifo_seq_ops}
@@ -1521,16 +4160,22 @@ DEADLINE_DISPATCH_ATTR(2);
 static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
 	DEADLINE_QUEUE_DDIR_ATTRS(read0),
 	DEADLINE_QUEUE_DDIR_ATTRS(write0),
+	DEADLINE_QUEUE_DDIR_ATTRS(append0),
 	DEADLINE_QUEUE_DDIR_ATTRS(read1),
 	DEADLINE_QUEUE_DDIR_ATTRS(write1),
+	DEADLINE_QUEUE_DDIR_ATTRS(append1),
 	DEADLINE_QUEUE_DDIR_ATTRS(read2),
 	DEADLINE_QUEUE_DDIR_ATTRS(write2),
+	DEADLINE_QUEUE_DDIR_ATTRS(append2),
 	DEADLINE_NEXT_RQ_ATTR(read0),
 	DEADLINE_NEXT_RQ_ATTR(write0),
+	DEADLINE_NEXT_RQ_ATTR(append0),
 	DEADLINE_NEXT_RQ_ATTR(read1),
 	DEADLINE_NEXT_RQ_ATTR(write1),
+	DEADLINE_NEXT_RQ_ATTR(append1),
 	DEADLINE_NEXT_RQ_ATTR(read2),
 	DEADLINE_NEXT_RQ_ATTR(write2),
+	DEADLINE_NEXT_RQ_ATTR(append2),
 	{"batching", 0400, deadline_batching_show},
 	{"starved", 0400, deadline_starved_show},
 	{"async_depth", 0400, dd_async_depth_show},
@@ -1539,6 +4184,18 @@ static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
 	{"dispatch2", 0400, .seq_ops = &deadline_dispatch2_seq_ops},
 	{"owned_by_driver", 0400, dd_owned_by_driver_show},
 	{"queued", 0400, dd_queued_show},
+	{"reset_queue0", 0400, .seq_ops = &zinc_reset0_queue_seq_ops},
+	{"reset_queue1", 0400, .seq_ops = &zinc_reset1_queue_seq_ops},
+	{"reset_queue2", 0400, .seq_ops = &zinc_reset2_queue_seq_ops},
+	{"finish_queue0", 0400, .seq_ops = &zinc_finish0_queue_seq_ops},
+	{"finish_queue1", 0400, .seq_ops = &zinc_finish1_queue_seq_ops},
+	{"finish_queue2", 0400, .seq_ops = &zinc_finish2_queue_seq_ops},
+	{"zinc_stats", 0400, zinc_stats_show},
+	{"zinc_accounting", 0400, zinc_accounting_show},
+	{"read_latency_hist", 0400, zinc_read_hist_show},
+	{"write_latency_hist", 0400, zinc_write_hist_show},
+	{"reset_latency_hist", 0400, zinc_reset_hist_show},
+	{"finish_latency_hist", 0400, zinc_finish_hist_show},
 	{},
 };
 #undef DEADLINE_QUEUE_DDIR_ATTRS
@@ -1551,6 +4208,7 @@ static struct elevator_type zinc = {
 		.insert_requests	= dd_insert_requests,
 		.dispatch_request	= dd_dispatch_request,
 		.prepare_request	= dd_prepare_request,
+		.requeue_request	= dd_requeue_request,
 		.finish_request		= dd_finish_request,
 		.next_request		= elv_rb_latter_request,
 		.former_request		= elv_rb_former_request,
@@ -1562,6 +4220,7 @@ static struct elevator_type zinc = {
 		.init_sched		= dd_init_sched,
 		.exit_sched		= dd_exit_sched,
 		.init_hctx		= dd_init_hctx,
+		.exit_hctx		= dd_exit_hctx,
 	},
 
 #ifdef CONFIG_BLK_DEBUG_FS
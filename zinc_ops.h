@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ZINC policy hooks
+ * Other modules can register a zinc_policy_ops to follow and override the management decisions
+ * of ZINC, without rebuilding or reloading the scheduler. A registered policy is selected per
+ * queue by writing its name to the `policy` sysfs knob, `default` selects the built-in cases.
+ * Policies are switched under RCU while requests are in flight, the queues are not drained.
+ *
+ * All hooks are optional and are called in atomic context, hooks must not sleep. Hooks marked
+ * with dd->lock are called with the scheduler lock held, a policy keeps its own locking for
+ * any state it shares between the other hooks.
+ */
+#ifndef _ZINC_OPS_H
+#define _ZINC_OPS_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+struct module;
+struct request;
+struct request_queue;
+
+#define ZINC_POLICY_NAME_MAX	32
+
+/* Decision of zinc_policy_ops->should_dispatch() */
+enum zinc_policy_verdict {
+	ZINC_POLICY_DEFAULT,	// decide with the built-in cases 0 to 2
+	ZINC_POLICY_ISSUE,	// issue the request now
+	ZINC_POLICY_HOLD,	// hold the request back, the next priority is tried
+};
+
+/* State of the oldest queued management request of a queue and priority */
+struct zinc_mgmt_state {
+	const char *queue;		// "reset" or "finish"
+	unsigned int prio;		// 0 (RT) to 2 (IDLE)
+	unsigned int holds;		// epochs the request has been held back
+	unsigned int cost;		// cost in percent, see zinc_policy_cost()
+	unsigned int nr_queued;		// queued requests of the queue, all priorities
+	int pending_writes;		// in-flight writes the request interferes with, in 8KiB units
+	int pending_reads;		// in-flight reads in 8KiB units, if tracked
+	int dispatched_writes;		// write tokens of the priority
+	int dispatched_reads;		// read tokens of the priority, if tracked
+	int command_tokens;		// tokens needed at cost 100, in the BE priority
+	int maximum_epoch_holds;
+	int minimum_concurrency_treshold;
+};
+
+struct zinc_policy_ops {
+	const char *name;
+	struct module *owner;
+
+	/* A management request has been queued (dd->lock) */
+	void (*mgmt_insert)(struct request_queue *q, struct request *rq);
+	/* An epoch of @queue started with @nr_queued requests queued (dd->lock) */
+	void (*epoch)(struct request_queue *q, const char *queue,
+		      unsigned int nr_queued);
+	/* A write of @units write units has been dispatched (dd->lock) */
+	void (*write_dispatch)(struct request_queue *q, struct request *rq,
+			       unsigned int units);
+	/* A write of @units write units completed or has been requeued */
+	void (*write_complete)(struct request_queue *q, struct request *rq,
+			       unsigned int units);
+	/*
+	 * Whether the oldest queued management request @rq may be issued in this epoch
+	 * (dd->lock). Idle windows and urgent requests are not subject to this hook.
+	 */
+	enum zinc_policy_verdict (*should_dispatch)(struct request_queue *q,
+						    struct request *rq,
+						    const struct zinc_mgmt_state *state);
+
+	struct list_head list;		// for ZINC, in the registered policies
+};
+
+int zinc_register_policy(struct zinc_policy_ops *ops);
+void zinc_unregister_policy(struct zinc_policy_ops *ops);
+
+#endif /* _ZINC_OPS_H */
@@ -0,0 +1,264 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ZINC policy core
+ * The decisions of the management queues (cases 0 to 3, command tokens, epoch holds and the
+ * cost model) on plain integers. This header is shared by the scheduler (zinc.c) and the
+ * userspace replay tool (tools/zinc-replay.c), so nothing in here may depend on the block
+ * layer or on kernel-only helpers.
+ */
+#ifndef _ZINC_POLICY_H
+#define _ZINC_POLICY_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/limits.h>
+#include <linux/math64.h>
+#define zinc_policy_div_u64(__a, __b)	div_u64(__a, __b)
+#else
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+typedef uint32_t u32;
+typedef uint64_t u64;
+#define zinc_policy_div_u64(__a, __b)	((__a) / (__b))
+#endif
+
+/*
+ * Default ZINC parameters
+ */
+static const int RESET_EPOCH_INTERVAL = 64;	// In ms (the interval is kept in us, see ZINC_MIN_EPOCH_INTERVAL)
+static const int RESET_COMMAND_TOKENS = 2000;
+static const int RESET_MINIMUM_CONCURRENCY_THRESHOLD = 3; // In number of resets
+static const int RESET_MAXIMUM_EPOCH_HOLDS = 3; // In number of retries
+static const int RESET_BATCH_SIZE = 1; // In number of resets per epoch
+
+static const int FINISH_EPOCH_INTERVAL = 64;	// In ms
+static const int FINISH_COMMAND_TOKENS = 2000;
+static const int FINISH_MINIMUM_CONCURRENCY_THRESHOLD = 3; // In number of resets
+static const int FINISH_MAXIMUM_EPOCH_HOLDS = 3; // In number of retries
+static const int FINISH_BATCH_SIZE = 1; // In number of finishes per epoch
+
+static const int ZINC_MIN_EPOCH_INTERVAL = 10;	// In us, lower bound of all epoch intervals
+
+/*
+ *  I/O Unit conversions
+ */
+#define ZINC_IO_SIZE_BIT_SHIFT	13	// We keep track of I/O sizes in 8KiB units
+
+/*
+ * Command tokens and epoch intervals are scaled by adapt_scale / ZINC_ADAPT_SCALE_UNIT, see
+ * struct zinc_adapt in zinc.c
+ */
+#define ZINC_ADAPT_SCALE_SHIFT	8
+#define ZINC_ADAPT_SCALE_UNIT	(1 << ZINC_ADAPT_SCALE_SHIFT)
+
+/*
+ * ZINC cost model, see zinc_policy_write_cost() and zinc_policy_cost()
+ */
+#define ZINC_COST_BUCKETS	8	// write size buckets: 8KiB, 16KiB, ..., 512KiB, 1MiB and larger
+#define ZINC_COST_UNIT		100	// costs and weights are in percent
+#define ZINC_MAX_COST		10000	// upper bound of the write cost weights
+
+/* Priorities, in the order of enum dd_prio: RT, BE, IDLE */
+#define ZINC_POLICY_PRIOS	3
+
+/* Reasons to issue a management request, see zinc_mgmt_pick() */
+enum zinc_mgmt_case {
+	ZINC_CASE_IDLE,		// case 0: below the concurrency threshold
+	ZINC_CASE_TOKENS,	// case 1: enough command tokens
+	ZINC_CASE_HOLDS,	// case 2: held back for the maximum number of epochs
+	ZINC_CASE_URGENT,	// urgent request, held back for the urgent number of epochs
+	ZINC_CASE_POLICY,	// issued by the selected policy, see zinc_ops.h
+	ZINC_CASE_POSTPONE,	// case 3: nothing can be issued, the batch ends
+	ZINC_NUM_CASES,
+};
+
+/*
+ * Command tokens needed per priority, in ZINC_ADAPT_SCALE_UNIT units. Management requests of
+ * RT tasks are issued after half the tokens, those of IDLE tasks need four times the tokens,
+ * so that an IDLE tenant's garbage collection is throttled harder.
+ */
+static const int zinc_prio_token_weight[ZINC_POLICY_PRIOS] = {
+	ZINC_ADAPT_SCALE_UNIT / 2,
+	ZINC_ADAPT_SCALE_UNIT,
+	ZINC_ADAPT_SCALE_UNIT * 4,
+};
+
+static inline int zinc_policy_clamp_int(long long value, long long lo)
+{
+	if (value < lo)
+		return lo;
+	return value > INT_MAX ? INT_MAX : value;
+}
+
+/* Size of an I/O of @bytes in 8KiB units. Smaller I/Os count as 1, the flash page size is 8KiB */
+static inline unsigned int zinc_policy_io_units(unsigned int bytes)
+{
+	unsigned int io_units = bytes >> ZINC_IO_SIZE_BIT_SHIFT;
+
+	return io_units ? io_units : 1;
+}
+
+/*
+ * Units charged for a write of @io_units 8KiB units, weighted by the write cost weight of its
+ * size bucket, so that large writes can be made cheaper per byte than small ones.
+ */
+static inline unsigned int zinc_policy_write_cost(const int *weights,
+						  unsigned int io_units)
+{
+	unsigned int bucket = 31 - __builtin_clz(io_units | 1);
+	u64 units;
+
+	if (bucket > ZINC_COST_BUCKETS - 1)
+		bucket = ZINC_COST_BUCKETS - 1;
+	units = (u64)io_units * weights[bucket];
+
+	return zinc_policy_clamp_int(zinc_policy_div_u64(units + ZINC_COST_UNIT - 1,
+							 ZINC_COST_UNIT), 1);
+}
+
+/* @value scaled by @scale / ZINC_ADAPT_SCALE_UNIT */
+static inline int zinc_policy_scale(int value, int scale)
+{
+	u64 scaled = (u64)value * scale;
+
+	return zinc_policy_clamp_int(scaled >> ZINC_ADAPT_SCALE_SHIFT, 0);
+}
+
+static inline int zinc_policy_prio_tokens(int tokens, unsigned int prio)
+{
+	return zinc_policy_scale(tokens, zinc_prio_token_weight[prio]);
+}
+
+/* Tokens needed by a request of priority @prio with cost @cost, see zinc_policy_cost() */
+static inline int zinc_policy_cost_tokens(int tokens, unsigned int prio,
+					  unsigned int cost)
+{
+	u64 weighted = (u64)zinc_policy_prio_tokens(tokens, prio) * cost;
+
+	return zinc_policy_clamp_int(zinc_policy_div_u64(weighted, ZINC_COST_UNIT), 0);
+}
+
+/*
+ * Cost of a management request in ZINC_COST_UNIT, with the zone @fill (in ZINC_COST_UNIT, -1 if
+ * unknown). Resetting a full zone costs the most, as all its blocks are erased, while finishing
+ * an empty zone costs the most, as the rest of the zone is filled. The cheapest case costs
+ * @min_cost, the cost grows linearly with the write pointer in between. Requests on zones of
+ * unknown state cost the full unit.
+ */
+static inline unsigned int zinc_policy_cost(int min_cost, int fill, bool finish)
+{
+	if (min_cost >= ZINC_COST_UNIT || fill < 0)
+		return ZINC_COST_UNIT;
+	if (fill > ZINC_COST_UNIT)
+		fill = ZINC_COST_UNIT;
+	if (finish)
+		fill = ZINC_COST_UNIT - fill;
+
+	return min_cost + (ZINC_COST_UNIT - min_cost) * fill / ZINC_COST_UNIT;
+}
+
+/*
+ * Tokens left after issuing one management request that needed @command_tokens. Tokens left
+ * over are kept for the remainder of the batch, but no more than the batch can use, so that a
+ * long period without management requests does not build up an unbounded burst.
+ */
+static inline int zinc_policy_consume(int tokens, int command_tokens,
+				      int batch_size)
+{
+	long long left = (long long)tokens - command_tokens;
+	long long max_tokens = (long long)(batch_size - 1) * command_tokens;
+
+	if (left > max_tokens)
+		left = max_tokens;
+	return zinc_policy_clamp_int(left, 0);
+}
+
+/* Number of epochs a request queued in epoch @queued has been held back by epoch @epoch. */
+static inline unsigned int zinc_policy_holds(unsigned int epoch,
+					     unsigned int queued)
+{
+	return epoch - queued;
+}
+
+/*
+ * case 0: (almost) nothing is in flight that the request interferes with. When @read_treshold
+ * is non-zero, the in-flight reads also need to be below it. A request that interferes with
+ * all writes (a reset of all zones) is only issued when no write is in flight.
+ */
+static inline bool zinc_policy_idle(int pending_writes, int write_treshold,
+				    int pending_reads, int read_treshold,
+				    bool all_zones)
+{
+	if (all_zones && pending_writes)
+		return false;
+	if (pending_writes >= write_treshold)
+		return false;
+
+	return !read_treshold || pending_reads < read_treshold;
+}
+
+/*
+ * case 1: enough writes (or reads, if @read_tokens is non-zero) have been dispatched since the
+ * last management request. @write_tokens and @read_tokens are the tokens of a request of cost
+ * ZINC_COST_UNIT and of the BE priority.
+ */
+static inline bool zinc_policy_tokens(int dispatched_writes, int write_tokens,
+				      int dispatched_reads, int read_tokens,
+				      unsigned int prio, unsigned int cost)
+{
+	if (dispatched_writes > zinc_policy_cost_tokens(write_tokens, prio, cost))
+		return true;
+
+	return read_tokens &&
+		dispatched_reads > zinc_policy_cost_tokens(read_tokens, prio, cost);
+}
+
+/* case 2: the request has been held back for the maximum number of epochs */
+static inline bool zinc_policy_held(unsigned int holds, int maximum_epoch_holds)
+{
+	return holds >= (unsigned int)maximum_epoch_holds;
+}
+
+/*
+ * Urgent requests: all queued requests are urgent once @nr_queued reached @urgent_queue_depth
+ * (0 disables this), an urgent request is issued once held back for @urgent_epoch_holds epochs.
+ */
+static inline bool zinc_policy_pressure(unsigned int nr_queued,
+					int urgent_queue_depth)
+{
+	return urgent_queue_depth > 0 &&
+		nr_queued >= (unsigned int)urgent_queue_depth;
+}
+
+static inline bool zinc_policy_urgent(unsigned int holds, int urgent_epoch_holds)
+{
+	return holds >= (unsigned int)urgent_epoch_holds;
+}
+
+/*
+ * Token bucket of the rate mode: tokens are kept in ZINC_BUCKET_OP per operation, so that
+ * refilling at @rate operations per second adds one token per nanosecond per operation.
+ */
+#define ZINC_BUCKET_OP	1000000000ULL
+
+/* Bucket @bucket after @elapsed_ns at @rate operations per second, holding at most @burst */
+static inline u64 zinc_policy_bucket_refill(u64 bucket, u64 elapsed_ns, int rate,
+					    int burst)
+{
+	u64 max_bucket = (u64)burst * ZINC_BUCKET_OP;
+
+	if (elapsed_ns >= zinc_policy_div_u64(max_bucket, rate))
+		return max_bucket;
+	bucket += elapsed_ns * rate;
+
+	return bucket > max_bucket ? max_bucket : bucket;
+}
+
+/* Tokens drawn by an operation of cost @cost, see zinc_policy_cost() */
+static inline u64 zinc_policy_bucket_cost(unsigned int cost)
+{
+	return zinc_policy_div_u64(ZINC_BUCKET_OP * cost, ZINC_COST_UNIT);
+}
+
+#endif /* _ZINC_POLICY_H */
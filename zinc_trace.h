@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ZINC management decisions, see zinc_mgmt_pick() and zinc_mgmt_dispatch() in zinc.c
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM zinc
+
+#if !defined(_TRACE_ZINC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ZINC_H
+
+#include <linux/blkdev.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(zinc_mgmt_issue,
+
+	TP_PROTO(struct request *rq, const char *name, unsigned int prio,
+		 unsigned int holds, int pending_writes, int pending_reads,
+		 int dispatched_writes, int dispatched_reads),
+
+	TP_ARGS(rq, name, prio, holds, pending_writes, pending_reads,
+		dispatched_writes, dispatched_reads),
+
+	TP_STRUCT__entry(
+		__field(dev_t,		dev)
+		__field(sector_t,	sector)
+		__string(name,		name)
+		__field(unsigned int,	prio)
+		__field(unsigned int,	holds)
+		__field(int,		pending_writes)
+		__field(int,		pending_reads)
+		__field(int,		dispatched_writes)
+		__field(int,		dispatched_reads)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= rq->q->disk ? disk_devt(rq->q->disk) : 0;
+		__entry->sector		= blk_rq_pos(rq);
+		__assign_str(name, name);
+		__entry->prio		= prio;
+		__entry->holds		= holds;
+		__entry->pending_writes	= pending_writes;
+		__entry->pending_reads	= pending_reads;
+		__entry->dispatched_writes = dispatched_writes;
+		__entry->dispatched_reads = dispatched_reads;
+	),
+
+	TP_printk("%d,%d %s %llu prio=%u holds=%u pending=%d/%d dispatched=%d/%d",
+		  MAJOR(__entry->dev), MINOR(__entry->dev), __get_str(name),
+		  (unsigned long long)__entry->sector, __entry->prio,
+		  __entry->holds, __entry->pending_writes, __entry->pending_reads,
+		  __entry->dispatched_writes, __entry->dispatched_reads)
+);
+
+/* case 0: (almost) nothing is in flight that the request interferes with */
+DEFINE_EVENT(zinc_mgmt_issue, zinc_mgmt_idle,
+
+	TP_PROTO(struct request *rq, const char *name, unsigned int prio,
+		 unsigned int holds, int pending_writes, int pending_reads,
+		 int dispatched_writes, int dispatched_reads),
+
+	TP_ARGS(rq, name, prio, holds, pending_writes, pending_reads,
+		dispatched_writes, dispatched_reads)
+);
+
+/* case 1: enough writes (or reads) have been dispatched since the last management request */
+DEFINE_EVENT(zinc_mgmt_issue, zinc_mgmt_tokens,
+
+	TP_PROTO(struct request *rq, const char *name, unsigned int prio,
+		 unsigned int holds, int pending_writes, int pending_reads,
+		 int dispatched_writes, int dispatched_reads),
+
+	TP_ARGS(rq, name, prio, holds, pending_writes, pending_reads,
+		dispatched_writes, dispatched_reads)
+);
+
+/* case 2: the request has been held back for the maximum number of epochs */
+DEFINE_EVENT(zinc_mgmt_issue, zinc_mgmt_holds,
+
+	TP_PROTO(struct request *rq, const char *name, unsigned int prio,
+		 unsigned int holds, int pending_writes, int pending_reads,
+		 int dispatched_writes, int dispatched_reads),
+
+	TP_ARGS(rq, name, prio, holds, pending_writes, pending_reads,
+		dispatched_writes, dispatched_reads)
+);
+
+/* an urgent request has been held back for the urgent number of epochs */
+DEFINE_EVENT(zinc_mgmt_issue, zinc_mgmt_urgent,
+
+	TP_PROTO(struct request *rq, const char *name, unsigned int prio,
+		 unsigned int holds, int pending_writes, int pending_reads,
+		 int dispatched_writes, int dispatched_reads),
+
+	TP_ARGS(rq, name, prio, holds, pending_writes, pending_reads,
+		dispatched_writes, dispatched_reads)
+);
+
+/* the selected policy issued the request, see zinc_ops.h */
+DEFINE_EVENT(zinc_mgmt_issue, zinc_mgmt_policy,
+
+	TP_PROTO(struct request *rq, const char *name, unsigned int prio,
+		 unsigned int holds, int pending_writes, int pending_reads,
+		 int dispatched_writes, int dispatched_reads),
+
+	TP_ARGS(rq, name, prio, holds, pending_writes, pending_reads,
+		dispatched_writes, dispatched_reads)
+);
+
+/* case 3: no queued request can be issued, the epoch is postponed if it just started */
+TRACE_EVENT(zinc_mgmt_postpone,
+
+	TP_PROTO(struct request_queue *q, const char *name, unsigned int nr_queued,
+		 int pending_writes, int pending_reads, bool new_epoch),
+
+	TP_ARGS(q, name, nr_queued, pending_writes, pending_reads, new_epoch),
+
+	TP_STRUCT__entry(
+		__field(dev_t,		dev)
+		__string(name,		name)
+		__field(unsigned int,	nr_queued)
+		__field(int,		pending_writes)
+		__field(int,		pending_reads)
+		__field(bool,		new_epoch)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= q->disk ? disk_devt(q->disk) : 0;
+		__assign_str(name, name);
+		__entry->nr_queued	= nr_queued;
+		__entry->pending_writes	= pending_writes;
+		__entry->pending_reads	= pending_reads;
+		__entry->new_epoch	= new_epoch;
+	),
+
+	TP_printk("%d,%d %s queued=%u pending=%d/%d%s",
+		  MAJOR(__entry->dev), MINOR(__entry->dev), __get_str(name),
+		  __entry->nr_queued, __entry->pending_writes,
+		  __entry->pending_reads, __entry->new_epoch ? " postponed" : "")
+);
+
+#endif /* _TRACE_ZINC_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE zinc_trace
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>